@@ -5,87 +5,243 @@
 #include <atomic>
 #include <chrono>
 #include <thread>
+#include "lock_wait.h"
 #include "rw_lock_guard.h"
+#if defined(TSCONTAINER_LOCK_STATS)
+#include "lock_stats.h"
+#endif
 
+namespace base {
 
+// Waiters spin with exponential backoff first and then park in a futex on
+// lock_num_; unlockers only issue the wake-up syscall when someone parked.
+//
+// lock_num_ is WRITE_EXCLUSIVE while a writer holds the lock, otherwise it
+// counts the readers, plus UPGRADE_LOCKED while an upgrader holds it.
 class AtomicRWLock{
 public:
     friend ReadLockGuard<AtomicRWLock>;
     friend WriteLockGuard<AtomicRWLock>;
+    friend UpgradeLockGuard<AtomicRWLock>;
     
     static const int32_t RW_LOCK_FREE = 0;
     static const int32_t WRITE_EXCLUSIVE = -1;
-    static const int32_t MAX_RETRY_TIMES = 5;
+    static const int32_t UPGRADE_LOCKED = 0x40000000;
 
     AtomicRWLock() = default;
     explicit AtomicRWLock(bool write_first):write_first_(write_first) { }
 
+#if defined(TSCONTAINER_LOCK_STATS)
+    // Acquisitions, waits, holds, spins and parks, see lock_stats.h.
+    LockStats* Stats() { return &stats_; }
+#endif
 
 private:
     bool write_first_ = true;
-    std::atomic<uint32_t> write_lock_wait_num_ = {0};
+    std::atomic<int32_t> write_lock_wait_num_ = {0};
     std::atomic<int32_t> lock_num_ = {0};
+    std::atomic<uint32_t> park_num_ = {0};
+#if defined(TSCONTAINER_LOCK_STATS)
+    LockStats stats_;
+#endif
 
     AtomicRWLock(const AtomicRWLock&) = delete;
     AtomicRWLock& operator=(const AtomicRWLock&) = delete;
 
-    void ReadLock();
+    void ReadLock() { ReadLockUntil(nullptr); }
+    bool TryReadLock();
+    bool TryReadLockUntil(const TimePoint& deadline) { return ReadLockUntil(&deadline); }
     void ReadUnLock();
 
-    void WriteLock();
+    void WriteLock() { WriteLockUntil(nullptr); }
+    bool TryWriteLock();
+    bool TryWriteLockUntil(const TimePoint& deadline) { return WriteLockUntil(&deadline); }
     void WriteUnLock();
+
+    void UpgradeLock();
+    void UpgradeUnLock();
+    void UpgradeToWriteLock();
+
+    bool ReadLockUntil(const TimePoint* deadline);
+    bool WriteLockUntil(const TimePoint* deadline);
+    bool ReadBlocked(int32_t temp_lock_num) const;
+    bool ReadWait(SpinBackoff& backoff, int32_t temp_lock_num,
+                  const TimePoint* deadline = nullptr);
+    bool Wait(SpinBackoff& backoff, std::atomic<int32_t>* word, int32_t value,
+              const TimePoint* deadline = nullptr);
+    void WriteWaitDone();
+    void WakeUp();
 };
 
 
-void AtomicRWLock::ReadLock()
+// Returns false once deadline has passed.
+inline bool AtomicRWLock::Wait(SpinBackoff& backoff, std::atomic<int32_t>* word,
+                               int32_t value, const TimePoint* deadline)
 {
-    uint32_t retry_times = 0;
-    int32_t temp_lock_num = lock_num_.load();
-    if(write_first_){
-        do{
-            while(temp_lock_num < RW_LOCK_FREE || write_lock_wait_num_.load() > 0 ){
-                if(++retry_times == MAX_RETRY_TIMES){
-                    std::this_thread::yield();
-                    retry_times = 0;
-                }
-                temp_lock_num = lock_num_.load();
-            }
-        }while(!lock_num_.compare_exchange_strong(temp_lock_num, temp_lock_num + 1,
-                                                std::memory_order_acq_rel, 
-                                                std::memory_order_relaxed));
+    if(deadline != nullptr && std::chrono::steady_clock::now() >= *deadline){
+        return false;
+    }
+    if(backoff.Spin()){
+#if defined(TSCONTAINER_LOCK_STATS)
+        stats_.OnSpin();
+#endif
+        return true;
+    }
+#if defined(TSCONTAINER_LOCK_STATS)
+    stats_.OnPark();
+#endif
+    park_num_.fetch_add(1);
+    if(deadline != nullptr){
+        FutexWaitUntil(word, value, *deadline);
     }else{
-        do{
-            while(temp_lock_num < RW_LOCK_FREE){
-                if(++retry_times == MAX_RETRY_TIMES){
-                    std::this_thread::yield();
-                    retry_times = 0;
-                }
-                temp_lock_num = lock_num_.load();
-            }
-        }while(!lock_num_.compare_exchange_strong(temp_lock_num, temp_lock_num + 1,
-                                                std::memory_order_acq_rel,
-                                                std::memory_order_relaxed));
+        FutexWait(word, value);
+    }
+    park_num_.fetch_sub(1);
+    backoff.Reset();
+    return true;
+}
+
+inline void AtomicRWLock::WakeUp()
+{
+    if(park_num_.load() > 0){
+        FutexWakeAll(&lock_num_);
+    }
+}
+
+inline void AtomicRWLock::WriteWaitDone()
+{
+    if(write_lock_wait_num_.fetch_sub(1) == 1 && park_num_.load() > 0){
+        FutexWakeAll(&write_lock_wait_num_);
     }
 }
 
-void AtomicRWLock::WriteLock()
+inline bool AtomicRWLock::ReadBlocked(int32_t temp_lock_num) const
+{
+    return temp_lock_num < RW_LOCK_FREE ||
+           (write_first_ && write_lock_wait_num_.load() > 0);
+}
+
+// Readers only held back by a waiting writer (write_first_) park on
+// write_lock_wait_num_, because a writer that times out leaves without
+// touching lock_num_.
+inline bool AtomicRWLock::ReadWait(SpinBackoff& backoff, int32_t temp_lock_num,
+                                   const TimePoint* deadline)
+{
+    int32_t write_wait_num = write_lock_wait_num_.load();
+    if(temp_lock_num >= RW_LOCK_FREE && write_first_ && write_wait_num > 0){
+        return Wait(backoff, &write_lock_wait_num_, write_wait_num, deadline);
+    }
+    return Wait(backoff, &lock_num_, temp_lock_num, deadline);
+}
+
+inline bool AtomicRWLock::ReadLockUntil(const TimePoint* deadline)
+{
+    SpinBackoff backoff;
+    int32_t temp_lock_num = lock_num_.load();
+    do{
+        while(ReadBlocked(temp_lock_num)){
+            if(!ReadWait(backoff, temp_lock_num, deadline)){
+                return false;
+            }
+            temp_lock_num = lock_num_.load();
+        }
+    }while(!lock_num_.compare_exchange_strong(temp_lock_num, temp_lock_num + 1,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed));
+    return true;
+}
+
+inline bool AtomicRWLock::TryReadLock()
+{
+    int32_t temp_lock_num = lock_num_.load();
+    do{
+        if(ReadBlocked(temp_lock_num)){
+            return false;
+        }
+    }while(!lock_num_.compare_exchange_weak(temp_lock_num, temp_lock_num + 1,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_relaxed));
+    return true;
+}
+
+inline bool AtomicRWLock::WriteLockUntil(const TimePoint* deadline)
 {
     int32_t rw_lock_free = RW_LOCK_FREE;
-    uint32_t retry_times = 0;
+    SpinBackoff backoff;
     write_lock_wait_num_.fetch_add(1);
     while(!lock_num_.compare_exchange_strong(rw_lock_free, WRITE_EXCLUSIVE,
                                             std::memory_order_acq_rel,
                                             std::memory_order_relaxed)){
+        if(!Wait(backoff, &lock_num_, rw_lock_free, deadline)){
+            // Lets the readers we were holding back go again.
+            WriteWaitDone();
+            return false;
+        }
         rw_lock_free = RW_LOCK_FREE;
-        if(++retry_times == MAX_RETRY_TIMES){
-            std::this_thread::yield();
-            retry_times = 0;
+    }
+    WriteWaitDone();
+    return true;
+}
+
+inline bool AtomicRWLock::TryWriteLock()
+{
+    int32_t rw_lock_free = RW_LOCK_FREE;
+    return lock_num_.compare_exchange_strong(rw_lock_free, WRITE_EXCLUSIVE,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_relaxed);
+}
+
+inline void AtomicRWLock::ReadUnLock()
+{
+    // Only the last reader can let a writer or an upgrading upgrader in.
+    int32_t temp_lock_num = lock_num_.fetch_sub(1) - 1;
+    if(temp_lock_num == RW_LOCK_FREE || temp_lock_num == UPGRADE_LOCKED){
+        WakeUp();
+    }
+}
+
+inline void AtomicRWLock::WriteUnLock()
+{
+    lock_num_.fetch_add(1);
+    WakeUp();
+}
+
+inline void AtomicRWLock::UpgradeLock()
+{
+    SpinBackoff backoff;
+    int32_t temp_lock_num = lock_num_.load();
+    do{
+        while(ReadBlocked(temp_lock_num) || (temp_lock_num & UPGRADE_LOCKED)){
+            ReadWait(backoff, temp_lock_num);
+            temp_lock_num = lock_num_.load();
         }
+    }while(!lock_num_.compare_exchange_strong(temp_lock_num, temp_lock_num | UPGRADE_LOCKED,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed));
+}
+
+inline void AtomicRWLock::UpgradeUnLock()
+{
+    // Wakes writers as well as upgraders waiting for the upgrade bit.
+    lock_num_.fetch_sub(UPGRADE_LOCKED);
+    WakeUp();
+}
+
+inline void AtomicRWLock::UpgradeToWriteLock()
+{
+    // Counting as a waiting writer keeps new readers out when write_first_.
+    int32_t upgrade_locked = UPGRADE_LOCKED;
+    SpinBackoff backoff;
+    write_lock_wait_num_.fetch_add(1);
+    while(!lock_num_.compare_exchange_strong(upgrade_locked, WRITE_EXCLUSIVE,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed)){
+        Wait(backoff, &lock_num_, upgrade_locked);
+        upgrade_locked = UPGRADE_LOCKED;
     }
-    write_lock_wait_num_.fetch_sub(1);
+    WriteWaitDone();
 }
 
-void AtomicRWLock::ReadUnLock() { lock_num_.fetch_sub(1); }
-void AtomicRWLock::WriteUnLock() { lock_num_.fetch_add(1); }
+}  // namespace base
 
-#endif /*__ATOMIC_RW_LOCK_H__*/
\ No newline at end of file
+#endif /*__ATOMIC_RW_LOCK_H__*/
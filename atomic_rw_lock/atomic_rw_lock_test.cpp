@@ -1,7 +1,20 @@
 #include <iostream>
+#include <vector>
+#if defined(__linux__)
+#include <time.h>
+#endif
 #include "atomic_rw_lock.h"
+#include "dist_rw_lock.h"
+#include "phase_fair_rw_lock.h"
 #include <gtest/gtest.h>
 
+using base::AtomicRWLock;
+using base::DistRWLock;
+using base::PhaseFairRWLock;
+using base::ReadLockGuard;
+using base::UpgradeLockGuard;
+using base::WriteLockGuard;
+
 TEST(ReentrantRWLockTest, read_lock) {
   int count = 0;
   int thread_init = 0;
@@ -60,6 +73,389 @@ TEST(ReentrantRWLockTest, write_lock) {
   t2.join();
 }
 
+TEST(ReentrantRWLockTest, park_and_wake) {
+  int count = 0;
+  AtomicRWLock lock;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 1000; j++) {
+        if (j % 4 == 0) {
+          WriteLockGuard<AtomicRWLock> lg(lock);
+          count++;
+        } else {
+          ReadLockGuard<AtomicRWLock> lg(lock);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(8 * 250, count);
+}
+
+#if defined(__linux__)
+TEST(ReentrantRWLockTest, waiter_sleeps) {
+  AtomicRWLock lock;
+  std::atomic<bool> locked(false);
+  double cpu_ms = 0;
+  std::thread writer([&]() {
+    WriteLockGuard<AtomicRWLock> lg(lock);
+    locked = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  });
+  while (!locked) {
+    std::this_thread::yield();
+  }
+  std::thread reader([&]() {
+    timespec begin, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    { ReadLockGuard<AtomicRWLock> lg(lock); }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    cpu_ms = (end.tv_sec - begin.tv_sec) * 1e3 +
+             (end.tv_nsec - begin.tv_nsec) / 1e6;
+  });
+  writer.join();
+  reader.join();
+  // A spinning reader would burn (almost) the whole 200ms.
+  EXPECT_LT(cpu_ms, 50);
+}
+#endif
+
+TEST(ReentrantRWLockTest, upgrade_lock) {
+  std::atomic<int> readers(0);
+  std::atomic<bool> upgraded(false);
+  std::atomic<bool> flag(true);
+  AtomicRWLock lock;
+  std::thread reader;
+  {
+    UpgradeLockGuard<AtomicRWLock> ulg(lock);
+    // Readers share the lock with the upgrader.
+    reader = std::thread([&]() {
+      ReadLockGuard<AtomicRWLock> lg(lock);
+      readers++;
+      while (flag) {
+        std::this_thread::yield();
+      }
+    });
+    while (readers != 1) {
+      std::this_thread::yield();
+    }
+    // The upgrade waits for the reader to leave.
+    flag = false;
+    ulg.Upgrade();
+    upgraded = true;
+    EXPECT_EQ(1, readers.load());
+    reader.join();
+  }
+  EXPECT_TRUE(upgraded);
+  WriteLockGuard<AtomicRWLock> lg(lock);
+}
+
+TEST(ReentrantRWLockTest, upgrade_excludes_upgraders) {
+  int value = 0;
+  AtomicRWLock lock;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 1000; j++) {
+        UpgradeLockGuard<AtomicRWLock> ulg(lock);
+        int read = value;
+        if (j % 2 == 0) {
+          ulg.Upgrade();
+          value = read + 1;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(8 * 500, value);
+}
+
+
+TEST(DistRWLockTest, read_lock) {
+  std::atomic<int> count(0);
+  std::atomic<bool> flag(true);
+  DistRWLock lock;
+  auto f = [&]() {
+    ReadLockGuard<DistRWLock> lg(lock);
+    count++;
+    while (flag) {
+      std::this_thread::yield();
+    }
+  };
+  std::thread t1(f);
+  std::thread t2(f);
+  while (count != 2) {
+    std::this_thread::yield();
+  }
+  flag = false;
+  t1.join();
+  t2.join();
+  {
+    ReadLockGuard<DistRWLock> lg1(lock);
+    { ReadLockGuard<DistRWLock> lg2(lock); }
+  }
+}
+
+TEST(DistRWLockTest, write_excludes_readers) {
+  int value = 0;
+  bool torn = false;
+  DistRWLock lock;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < 2000; j++) {
+        if (i == 0 || j % 50 == 0) {
+          WriteLockGuard<DistRWLock> lg(lock);
+          value++;
+          value++;
+        } else {
+          ReadLockGuard<DistRWLock> lg(lock);
+          if (value % 2 != 0) {
+            torn = true;
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(torn);
+  EXPECT_EQ(2 * (2000 + 7 * 40), value);
+}
+
+TEST(PhaseFairRWLockTest, read_lock) {
+  std::atomic<int> count(0);
+  std::atomic<bool> flag(true);
+  PhaseFairRWLock lock;
+  auto f = [&]() {
+    ReadLockGuard<PhaseFairRWLock> lg(lock);
+    count++;
+    while (flag) {
+      std::this_thread::yield();
+    }
+  };
+  std::thread t1(f);
+  std::thread t2(f);
+  while (count != 2) {
+    std::this_thread::yield();
+  }
+  flag = false;
+  t1.join();
+  t2.join();
+}
+
+TEST(PhaseFairRWLockTest, bounded_wait) {
+  typedef std::chrono::steady_clock Clock;
+  int value = 0;
+  bool torn = false;
+  std::atomic<int64_t> max_read_wait_us(0);
+  std::atomic<int64_t> max_write_wait_us(0);
+  PhaseFairRWLock lock;
+  auto update_max = [](std::atomic<int64_t>& max, int64_t v) {
+    int64_t cur = max.load();
+    while (v > cur && !max.compare_exchange_weak(cur, v)) {
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    // Half readers, half writers, all hammering the lock back to back.
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < 2000; j++) {
+        auto begin = Clock::now();
+        if (i % 2 == 0) {
+          WriteLockGuard<PhaseFairRWLock> lg(lock);
+          update_max(max_write_wait_us,
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         Clock::now() - begin).count());
+          value++;
+          value++;
+        } else {
+          ReadLockGuard<PhaseFairRWLock> lg(lock);
+          update_max(max_read_wait_us,
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                         Clock::now() - begin).count());
+          if (value % 2 != 0) {
+            torn = true;
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(torn);
+  EXPECT_EQ(2 * 4 * 2000, value);
+  // Nobody is starved: a waiter sits behind at most one phase of each kind,
+  // the bound is generous only to absorb scheduler noise.
+  EXPECT_LT(max_read_wait_us.load(), 500000);
+  EXPECT_LT(max_write_wait_us.load(), 500000);
+  std::cout << "max read wait " << max_read_wait_us << "us, max write wait "
+            << max_write_wait_us << "us" << std::endl;
+}
+
+template <typename RWLock>
+void ExpectTryLock(RWLock& lock) {
+  auto soon = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+  {
+    WriteLockGuard<RWLock> lg(lock);
+    std::thread t([&]() {
+      ReadLockGuard<RWLock> try_read(lock, std::try_to_lock);
+      EXPECT_FALSE(try_read.OwnsLock());
+      WriteLockGuard<RWLock> try_write(lock, std::try_to_lock);
+      EXPECT_FALSE(try_write.OwnsLock());
+      ReadLockGuard<RWLock> timed_read(lock, soon);
+      EXPECT_FALSE(timed_read.OwnsLock());
+      WriteLockGuard<RWLock> timed_write(lock, soon);
+      EXPECT_FALSE(timed_write.OwnsLock());
+    });
+    t.join();
+  }
+  {
+    ReadLockGuard<RWLock> lg(lock);
+    std::thread t([&]() {
+      {
+        ReadLockGuard<RWLock> try_read(lock, std::try_to_lock);
+        EXPECT_TRUE(try_read.OwnsLock());
+      }
+      WriteLockGuard<RWLock> timed_write(
+          lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+      EXPECT_FALSE(timed_write.OwnsLock());
+    });
+    t.join();
+  }
+  // A writer that timed out must not keep readers or writers out.
+  {
+    ReadLockGuard<RWLock> try_read(lock, std::try_to_lock);
+    EXPECT_TRUE(try_read.OwnsLock());
+  }
+  WriteLockGuard<RWLock> try_write(lock, std::try_to_lock);
+  EXPECT_TRUE(try_write.OwnsLock());
+}
+
+TEST(ReentrantRWLockTest, try_lock) {
+  AtomicRWLock lock;
+  ExpectTryLock(lock);
+}
+
+TEST(ReentrantRWLockTest, timed_out_writer_wakes_readers) {
+  AtomicRWLock lock;
+  std::atomic<bool> read(false);
+  ReadLockGuard<AtomicRWLock> lg(lock);
+  std::thread writer([&]() {
+    WriteLockGuard<AtomicRWLock> timed_write(
+        lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+    EXPECT_FALSE(timed_write.OwnsLock());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  // Held back by the waiting writer, then parked.
+  std::thread reader([&]() {
+    ReadLockGuard<AtomicRWLock> lg(lock);
+    read = true;
+  });
+  writer.join();
+  reader.join();
+  EXPECT_TRUE(read);
+}
+
+TEST(DistRWLockTest, try_lock) {
+  DistRWLock lock;
+  ExpectTryLock(lock);
+}
+
+TEST(PhaseFairRWLockTest, try_lock) {
+  PhaseFairRWLock lock;
+  ExpectTryLock(lock);
+}
+
+// A failed TryWriteLock must not break the alternation of writer phase ids:
+// a reader queued behind one writer, and not yet woken when it leaves, has
+// to get in before the next writer.
+TEST(PhaseFairRWLockTest, try_write_keeps_phases) {
+  PhaseFairRWLock lock;
+  for (int round = 0; round < 20; ++round) {
+    std::atomic<bool> read(false);
+    std::thread reader;
+    {
+      WriteLockGuard<PhaseFairRWLock> lg(lock);
+      reader = std::thread([&]() {
+        ReadLockGuard<PhaseFairRWLock> rlg(lock);
+        read = true;
+      });
+      // queued behind the writer, then parked
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // Most likely fails: the reader is counted in but not woken up yet.
+    {
+      WriteLockGuard<PhaseFairRWLock> try_write(lock, std::try_to_lock);
+    }
+    {
+      WriteLockGuard<PhaseFairRWLock> lg(lock);
+    }
+    reader.join();
+    EXPECT_TRUE(read);
+  }
+}
+
+// The reader counters step by 0x100 and wrap after 2^24 read locks.
+TEST(PhaseFairRWLockTest, counter_wrap) {
+  PhaseFairRWLock lock;
+  for (int i = 0; i < (1 << 24) + 5; ++i) {
+    ReadLockGuard<PhaseFairRWLock> lg(lock);
+    if (i % (1 << 22) == 0) {
+      WriteLockGuard<PhaseFairRWLock> try_write(lock, std::try_to_lock);
+      EXPECT_FALSE(try_write.OwnsLock());
+    }
+  }
+  ExpectTryLock(lock);
+  WriteLockGuard<PhaseFairRWLock> lg(lock);
+}
+
+#if defined(TSCONTAINER_LOCK_STATS)
+TEST(ReentrantRWLockTest, stats) {
+  AtomicRWLock lock;
+  { ReadLockGuard<AtomicRWLock> lg(lock); }
+  {
+    UpgradeLockGuard<AtomicRWLock> lg(lock);
+    lg.Upgrade();
+  }
+  std::atomic<bool> locked(false);
+  std::thread writer([&]() {
+    WriteLockGuard<AtomicRWLock> lg(lock);
+    locked = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  });
+  while (!locked) {
+    std::this_thread::yield();
+  }
+  { ReadLockGuard<AtomicRWLock> lg(lock); }
+  writer.join();
+  base::LockStatsSnapshot s = lock.Stats()->Snapshot();
+  EXPECT_EQ(2u, s.read_acquires);
+  EXPECT_EQ(1u, s.write_acquires);
+  EXPECT_EQ(1u, s.upgrade_acquires);
+  EXPECT_EQ(1u, s.upgrades);
+  EXPECT_GT(s.spins, 0u);
+  EXPECT_GT(s.parks, 0u);
+  uint64_t waits = 0, holds = 0;
+  for (uint32_t i = 0; i < base::LOCK_HIST_BUCKETS; i++) {
+    waits += s.wait_hist[i];
+    holds += s.read_hold_hist[i] + s.write_hold_hist[i];
+  }
+  EXPECT_EQ(4u, waits);
+  EXPECT_EQ(4u, holds);
+  // the writer slept 20ms inside, so did the blocked reader outside
+  EXPECT_GE(s.max_write_hold_ns, 20000000u);
+  EXPECT_GE(base::LockStatsSnapshot::Quantile(s.wait_hist, 1.0), 10000000u);
+}
+#endif
+
 
 int main(int argc, char *argv[])
 {
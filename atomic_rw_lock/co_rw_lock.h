@@ -0,0 +1,270 @@
+#ifndef __CO_RW_LOCK_H__
+#define __CO_RW_LOCK_H__
+
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "lock_wait.h"
+#include "rw_lock_guard.h"
+
+namespace base {
+
+// Readers-writer lock for coroutines. `co_await lock.Read()` and
+// `co_await lock.Write()` suspend the coroutine instead of blocking the
+// thread when the lock is busy; the waiter is resumed through an executor
+// once the lock has been handed to it. The result of the co_await is the
+// guard that owns the lock:
+//
+//   auto guard = co_await lock.Write(executor);
+//
+// Threads can use the same lock through ReadLockGuard/WriteLockGuard, they
+// queue up with the coroutines in one FIFO and sleep in a futex. Without an
+// executor, waiters are resumed inline by the thread releasing the lock.
+class CoRWLock{
+public:
+    friend ReadLockGuard<CoRWLock>;
+    friend WriteLockGuard<CoRWLock>;
+    friend UpgradeLockGuard<CoRWLock>;
+
+    using Executor = std::function<void(std::coroutine_handle<>)>;
+
+    static const int32_t RW_LOCK_FREE = 0;
+    static const int32_t WRITE_EXCLUSIVE = -1;
+
+    template <typename Guard, bool WRITE>
+    class Awaiter{
+    public:
+        Awaiter(CoRWLock& lock, Executor executor)
+            :lock_(lock), executor_(std::move(executor)) { }
+        bool await_ready() { return WRITE ? lock_.TryWriteLock() : lock_.TryReadLock(); }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            return lock_.Enqueue(handle, WRITE, std::move(executor_));
+        }
+        Guard await_resume() { return Guard(lock_, std::adopt_lock); }
+    private:
+        CoRWLock& lock_;
+        Executor executor_;
+    };
+
+    using ReadAwaiter = Awaiter<ReadLockGuard<CoRWLock>, false>;
+    using WriteAwaiter = Awaiter<WriteLockGuard<CoRWLock>, true>;
+
+    CoRWLock() = default;
+    explicit CoRWLock(Executor executor):executor_(std::move(executor)) { }
+
+    // An empty executor falls back to the one given to the constructor.
+    ReadAwaiter Read(Executor executor = nullptr)
+    {
+        return ReadAwaiter(*this, executor ? std::move(executor) : executor_);
+    }
+    WriteAwaiter Write(Executor executor = nullptr)
+    {
+        return WriteAwaiter(*this, executor ? std::move(executor) : executor_);
+    }
+
+private:
+    struct Waiter{
+        bool write;
+        // either a suspended coroutine and its executor ...
+        std::coroutine_handle<> handle;
+        Executor executor;
+        // ... or a blocked thread
+        std::atomic<int32_t>* granted;
+    };
+
+    Executor executor_;
+    std::mutex mutex_;
+    int32_t lock_num_ = RW_LOCK_FREE;
+    std::deque<Waiter> waiters_;
+
+    CoRWLock(const CoRWLock&) = delete;
+    CoRWLock& operator=(const CoRWLock&) = delete;
+
+    void ReadLock() { LockUntil(false, nullptr); }
+    bool TryReadLock();
+    bool TryReadLockUntil(const TimePoint& deadline) { return LockUntil(false, &deadline); }
+    void ReadUnLock();
+
+    void WriteLock() { LockUntil(true, nullptr); }
+    bool TryWriteLock();
+    bool TryWriteLockUntil(const TimePoint& deadline) { return LockUntil(true, &deadline); }
+    void WriteUnLock();
+
+    // No upgradable mode, upgraders take the write lock up front.
+    void UpgradeLock() { WriteLock(); }
+    void UpgradeUnLock() { WriteUnLock(); }
+    void UpgradeToWriteLock() { }
+
+    bool Acquirable(bool write) const;
+    bool LockUntil(bool write, const TimePoint* deadline);
+    bool Enqueue(std::coroutine_handle<> handle, bool write, Executor executor);
+    void Release();
+};
+
+
+inline bool CoRWLock::Acquirable(bool write) const
+{
+    // Nobody overtakes a queued waiter.
+    if(!waiters_.empty()){
+        return false;
+    }
+    return write ? lock_num_ == RW_LOCK_FREE : lock_num_ >= RW_LOCK_FREE;
+}
+
+inline bool CoRWLock::TryReadLock()
+{
+    std::lock_guard<std::mutex> lg(mutex_);
+    if(!Acquirable(false)){
+        return false;
+    }
+    ++lock_num_;
+    return true;
+}
+
+inline bool CoRWLock::TryWriteLock()
+{
+    std::lock_guard<std::mutex> lg(mutex_);
+    if(!Acquirable(true)){
+        return false;
+    }
+    lock_num_ = WRITE_EXCLUSIVE;
+    return true;
+}
+
+inline bool CoRWLock::LockUntil(bool write, const TimePoint* deadline)
+{
+    std::atomic<int32_t> granted = {0};
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        if(Acquirable(write)){
+            lock_num_ = write ? WRITE_EXCLUSIVE : lock_num_ + 1;
+            return true;
+        }
+        waiters_.push_back(Waiter{write, nullptr, nullptr, &granted});
+    }
+    while(granted.load() == 0){
+        if(deadline == nullptr){
+            FutexWait(&granted, 0);
+        }else if(std::chrono::steady_clock::now() < *deadline){
+            FutexWaitUntil(&granted, 0, *deadline);
+        }else{
+            break;
+        }
+    }
+    std::unique_lock<std::mutex> ul(mutex_);
+    if(granted.load() != 0){
+        return true;
+    }
+    for(auto it = waiters_.begin(); it != waiters_.end(); ++it){
+        if(it->granted == &granted){
+            waiters_.erase(it);
+            break;
+        }
+    }
+    // Readers queued behind a writer that gave up may be able to go now.
+    ul.unlock();
+    Release();
+    return false;
+}
+
+inline bool CoRWLock::Enqueue(std::coroutine_handle<> handle, bool write,
+                              Executor executor)
+{
+    std::lock_guard<std::mutex> lg(mutex_);
+    if(Acquirable(write)){
+        lock_num_ = write ? WRITE_EXCLUSIVE : lock_num_ + 1;
+        return false;
+    }
+    waiters_.push_back(Waiter{write, handle, std::move(executor), nullptr});
+    return true;
+}
+
+inline void CoRWLock::ReadUnLock()
+{
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        --lock_num_;
+    }
+    Release();
+}
+
+inline void CoRWLock::WriteUnLock()
+{
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        lock_num_ = RW_LOCK_FREE;
+    }
+    Release();
+}
+
+// Hands the lock to the waiters at the head of the queue: one writer, or
+// every reader up to the next writer.
+inline void CoRWLock::Release()
+{
+    std::vector<Waiter> ready;
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        while(!waiters_.empty()){
+            Waiter& waiter = waiters_.front();
+            if(waiter.write ? lock_num_ != RW_LOCK_FREE : lock_num_ < RW_LOCK_FREE){
+                break;
+            }
+            lock_num_ = waiter.write ? WRITE_EXCLUSIVE : lock_num_ + 1;
+            if(waiter.granted != nullptr){
+                // The waiter re-checks under mutex_ before it returns, so
+                // its flag is still alive here.
+                waiter.granted->store(1);
+                FutexWakeAll(waiter.granted);
+            }else{
+                ready.push_back(std::move(waiter));
+            }
+            waiters_.pop_front();
+        }
+    }
+    for(auto& waiter : ready){
+        if(waiter.executor){
+            waiter.executor(waiter.handle);
+        }else{
+            waiter.handle.resume();
+        }
+    }
+}
+
+// Awaits the lock behind awaiter, then runs call while holding it; the
+// result of call is the result of the co_await.
+template <typename LockAwaiter, typename Call>
+class CoLockedCall{
+public:
+    CoLockedCall(LockAwaiter awaiter, Call call)
+        :awaiter_(std::move(awaiter)), call_(std::move(call)) { }
+    bool await_ready() { return awaiter_.await_ready(); }
+    bool await_suspend(std::coroutine_handle<> handle) { return awaiter_.await_suspend(handle); }
+    auto await_resume()
+    {
+        auto guard = awaiter_.await_resume();
+        return call_();
+    }
+private:
+    LockAwaiter awaiter_;
+    Call call_;
+};
+
+template <typename LockAwaiter, typename Call>
+CoLockedCall<LockAwaiter, Call> CoLocked(LockAwaiter awaiter, Call call)
+{
+    return CoLockedCall<LockAwaiter, Call>(std::move(awaiter), std::move(call));
+}
+
+}  // namespace base
+
+#endif /*__cpp_impl_coroutine*/
+
+#endif /*__CO_RW_LOCK_H__*/
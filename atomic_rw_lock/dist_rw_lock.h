@@ -0,0 +1,217 @@
+#ifndef __DIST_RW_LOCK_H__
+#define __DIST_RW_LOCK_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "lock_wait.h"
+#include "rw_lock_guard.h"
+
+namespace base {
+
+// Big-reader lock for read-mostly data with per-thread reader slots. A
+// reader increments the counter of its own cache-line-padded slot (picked
+// per thread), so readers never write a cache line shared with readers on
+// other cores. The writer flag is an odd version_: a reader that finds it
+// set, or set while it was entering, leaves its slot again and waits. A
+// writer sets the flag, drains all slots before it enters and clears the
+// flag when it leaves.
+//
+// Readers always hold a real read lock; nothing is read optimistically and
+// validated afterwards, so they can follow pointers of node-based
+// containers safely.
+//
+// Writers are always preferred: taking a nested read lock while a writer is
+// waiting dead-locks, exactly like AtomicRWLock with write_first.
+// The lock costs READER_SLOT_NUM cache lines of memory.
+class DistRWLock{
+public:
+    friend ReadLockGuard<DistRWLock>;
+    friend WriteLockGuard<DistRWLock>;
+    friend UpgradeLockGuard<DistRWLock>;
+
+    static const uint32_t READER_SLOT_NUM = 64;
+
+    DistRWLock() = default;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) ReaderSlot{
+        std::atomic<int32_t> reader_num = {0};
+    };
+
+    ReaderSlot slots_[READER_SLOT_NUM];
+    // odd while a writer drains or holds the lock
+    alignas(CACHE_LINE_SIZE) std::atomic<int32_t> version_ = {0};
+    // bumped by readers leaving while a writer drains, so it can sleep on it
+    std::atomic<int32_t> drain_seq_ = {0};
+    std::atomic<uint32_t> park_num_ = {0};
+
+    DistRWLock(const DistRWLock&) = delete;
+    DistRWLock& operator=(const DistRWLock&) = delete;
+
+    void ReadLock() { ReadLockUntil(nullptr); }
+    bool TryReadLock();
+    bool TryReadLockUntil(const TimePoint& deadline) { return ReadLockUntil(&deadline); }
+    void ReadUnLock();
+
+    void WriteLock() { WriteLockUntil(nullptr); }
+    bool TryWriteLock();
+    bool TryWriteLockUntil(const TimePoint& deadline) { return WriteLockUntil(&deadline); }
+    void WriteUnLock();
+
+    // No upgradable mode, upgraders take the write lock up front.
+    void UpgradeLock() { WriteLock(); }
+    void UpgradeUnLock() { WriteUnLock(); }
+    void UpgradeToWriteLock() { }
+
+    static bool WriterIn(int32_t version) { return (version & 1) != 0; }
+    static std::atomic<int32_t>& ThisThreadSlot(DistRWLock* lock);
+    bool ReaderEnter(std::atomic<int32_t>& slot, int32_t version);
+    void ReaderLeave(std::atomic<int32_t>& slot);
+    bool ReadLockUntil(const TimePoint* deadline);
+    bool WriteLockUntil(const TimePoint* deadline);
+    bool Drained() const;
+    bool Wait(SpinBackoff& backoff, std::atomic<int32_t>* word, int32_t value,
+              const TimePoint* deadline = nullptr);
+    void WakeUp(std::atomic<int32_t>* word);
+};
+
+
+inline std::atomic<int32_t>& DistRWLock::ThisThreadSlot(DistRWLock* lock)
+{
+    static std::atomic<uint32_t> thread_num = {0};
+    static thread_local uint32_t slot = thread_num.fetch_add(1) % READER_SLOT_NUM;
+    return lock->slots_[slot].reader_num;
+}
+
+// Returns false once deadline has passed.
+inline bool DistRWLock::Wait(SpinBackoff& backoff, std::atomic<int32_t>* word,
+                             int32_t value, const TimePoint* deadline)
+{
+    if(deadline != nullptr && std::chrono::steady_clock::now() >= *deadline){
+        return false;
+    }
+    if(backoff.Spin()){
+        return true;
+    }
+    park_num_.fetch_add(1);
+    if(deadline != nullptr){
+        FutexWaitUntil(word, value, *deadline);
+    }else{
+        FutexWait(word, value);
+    }
+    park_num_.fetch_sub(1);
+    backoff.Reset();
+    return true;
+}
+
+inline void DistRWLock::WakeUp(std::atomic<int32_t>* word)
+{
+    if(park_num_.load() > 0){
+        FutexWakeAll(word);
+    }
+}
+
+// Enters with the even version read before; steps back and returns false
+// if a writer bumped it meanwhile.
+inline bool DistRWLock::ReaderEnter(std::atomic<int32_t>& slot, int32_t version)
+{
+    slot.fetch_add(1);
+    if(version_.load() == version){
+        return true;
+    }
+    ReaderLeave(slot);
+    return false;
+}
+
+inline void DistRWLock::ReaderLeave(std::atomic<int32_t>& slot)
+{
+    slot.fetch_sub(1);
+    if(WriterIn(version_.load())){
+        drain_seq_.fetch_add(1);
+        WakeUp(&drain_seq_);
+    }
+}
+
+inline bool DistRWLock::ReadLockUntil(const TimePoint* deadline)
+{
+    std::atomic<int32_t>& slot = ThisThreadSlot(this);
+    SpinBackoff backoff;
+    int32_t version = version_.load();
+    while(WriterIn(version) || !ReaderEnter(slot, version)){
+        if(WriterIn(version) && !Wait(backoff, &version_, version, deadline)){
+            return false;
+        }
+        version = version_.load();
+    }
+    return true;
+}
+
+inline bool DistRWLock::TryReadLock()
+{
+    int32_t version = version_.load();
+    return !WriterIn(version) && ReaderEnter(ThisThreadSlot(this), version);
+}
+
+inline void DistRWLock::ReadUnLock()
+{
+    ReaderLeave(ThisThreadSlot(this));
+}
+
+inline bool DistRWLock::WriteLockUntil(const TimePoint* deadline)
+{
+    SpinBackoff backoff;
+    int32_t version = version_.load();
+    while(WriterIn(version) || !version_.compare_exchange_strong(version, version + 1)){
+        if(WriterIn(version) && !Wait(backoff, &version_, version, deadline)){
+            return false;
+        }
+        version = version_.load();
+    }
+    backoff.Reset();
+    for(uint32_t i = 0; i < READER_SLOT_NUM; ++i){
+        int32_t drain_seq = drain_seq_.load();
+        while(slots_[i].reader_num.load() != 0){
+            if(!Wait(backoff, &drain_seq_, drain_seq, deadline)){
+                // Let the readers we turned away back in.
+                WriteUnLock();
+                return false;
+            }
+            drain_seq = drain_seq_.load();
+        }
+    }
+    return true;
+}
+
+inline bool DistRWLock::Drained() const
+{
+    for(uint32_t i = 0; i < READER_SLOT_NUM; ++i){
+        if(slots_[i].reader_num.load() != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool DistRWLock::TryWriteLock()
+{
+    int32_t version = version_.load();
+    if(WriterIn(version) || !version_.compare_exchange_strong(version, version + 1)){
+        return false;
+    }
+    if(!Drained()){
+        WriteUnLock();
+        return false;
+    }
+    return true;
+}
+
+inline void DistRWLock::WriteUnLock()
+{
+    version_.fetch_add(1);
+    WakeUp(&version_);
+}
+
+}  // namespace base
+
+#endif /*__DIST_RW_LOCK_H__*/
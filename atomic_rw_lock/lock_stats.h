@@ -0,0 +1,211 @@
+#ifndef __LOCK_STATS_H__
+#define __LOCK_STATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace base {
+
+// Lock instrumentation, compiled in only with TSCONTAINER_LOCK_STATS
+// defined. A lock opts in by providing LockStats* Stats(); the guards then
+// time every acquisition (wait) and every critical section (hold), and the
+// lock itself counts its spin rounds and futex parks. Without the macro the
+// guards and locks carry no extra member and no extra instruction.
+
+enum class LockMode{
+    READ,
+    WRITE,
+    // upgradable lock, until Upgrade(); the hold is counted as WRITE after
+    UPGRADE
+};
+
+// Durations in bucket i of a histogram lie in [2^(i-1), 2^i) ns; bucket 0
+// holds 0 ns and the last bucket everything longer.
+static const uint32_t LOCK_HIST_BUCKETS = 32;
+
+// Totals of one lock, summed over all threads.
+struct LockStatsSnapshot{
+    uint64_t read_acquires = 0;
+    uint64_t write_acquires = 0;
+    uint64_t upgrade_acquires = 0;
+    // UpgradeLockGuard::Upgrade() calls
+    uint64_t upgrades = 0;
+    // backoff rounds spent spinning, and sleeps in the futex
+    uint64_t spins = 0;
+    uint64_t parks = 0;
+    uint64_t wait_hist[LOCK_HIST_BUCKETS] = {};
+    uint64_t read_hold_hist[LOCK_HIST_BUCKETS] = {};
+    uint64_t write_hold_hist[LOCK_HIST_BUCKETS] = {};
+    uint64_t max_read_hold_ns = 0;
+    uint64_t max_write_hold_ns = 0;
+
+    // Upper bound in ns of the bucket holding quantile q (0..1) of hist.
+    static uint64_t Quantile(const uint64_t* hist, double q)
+    {
+        uint64_t total = 0;
+        for(uint32_t i = 0; i < LOCK_HIST_BUCKETS; ++i){
+            total += hist[i];
+        }
+        uint64_t seen = 0;
+        for(uint32_t i = 0; i < LOCK_HIST_BUCKETS; ++i){
+            seen += hist[i];
+            if(total > 0 && seen >= q * total){
+                return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+            }
+        }
+        return 0;
+    }
+};
+
+// Counters of one lock, kept in cache-line-padded per-thread slots (picked
+// per thread like DistRWLock's reader slots), so recording never writes a
+// line shared with other cores; Snapshot() sums them up on demand.
+class LockStats{
+public:
+    static const uint32_t SLOT_NUM = 16;
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void OnAcquire(LockMode mode, uint64_t wait_ns)
+    {
+        Slot& s = ThisThreadSlot();
+        Add(mode == LockMode::READ    ? s.read_acquires
+            : mode == LockMode::WRITE ? s.write_acquires
+                                      : s.upgrade_acquires);
+        Add(s.wait_hist[Bucket(wait_ns)]);
+    }
+    void OnUpgrade() { Add(ThisThreadSlot().upgrades); }
+    void OnRelease(LockMode mode, uint64_t hold_ns)
+    {
+        Slot& s = ThisThreadSlot();
+        bool read = mode == LockMode::READ;
+        Add((read ? s.read_hold_hist : s.write_hold_hist)[Bucket(hold_ns)]);
+        std::atomic<uint64_t>& max = read ? s.max_read_hold : s.max_write_hold;
+        uint64_t old = max.load(std::memory_order_relaxed);
+        while(old < hold_ns &&
+              !max.compare_exchange_weak(old, hold_ns, std::memory_order_relaxed)){
+        }
+    }
+    void OnSpin() { Add(ThisThreadSlot().spins); }
+    void OnPark() { Add(ThisThreadSlot().parks); }
+
+    LockStatsSnapshot Snapshot() const
+    {
+        LockStatsSnapshot r;
+        for(const Slot& s : slots_){
+            r.read_acquires += Load(s.read_acquires);
+            r.write_acquires += Load(s.write_acquires);
+            r.upgrade_acquires += Load(s.upgrade_acquires);
+            r.upgrades += Load(s.upgrades);
+            r.spins += Load(s.spins);
+            r.parks += Load(s.parks);
+            for(uint32_t i = 0; i < LOCK_HIST_BUCKETS; ++i){
+                r.wait_hist[i] += Load(s.wait_hist[i]);
+                r.read_hold_hist[i] += Load(s.read_hold_hist[i]);
+                r.write_hold_hist[i] += Load(s.write_hold_hist[i]);
+            }
+            if(Load(s.max_read_hold) > r.max_read_hold_ns){
+                r.max_read_hold_ns = Load(s.max_read_hold);
+            }
+            if(Load(s.max_write_hold) > r.max_write_hold_ns){
+                r.max_write_hold_ns = Load(s.max_write_hold);
+            }
+        }
+        return r;
+    }
+
+private:
+    using Counter = std::atomic<uint64_t>;
+    // padded to a cache line; lock_wait.h includes this header indirectly
+    struct alignas(64) Slot{
+        Counter read_acquires = {0};
+        Counter write_acquires = {0};
+        Counter upgrade_acquires = {0};
+        Counter upgrades = {0};
+        Counter spins = {0};
+        Counter parks = {0};
+        Counter max_read_hold = {0};
+        Counter max_write_hold = {0};
+        Counter wait_hist[LOCK_HIST_BUCKETS] = {};
+        Counter read_hold_hist[LOCK_HIST_BUCKETS] = {};
+        Counter write_hold_hist[LOCK_HIST_BUCKETS] = {};
+    };
+
+    Slot slots_[SLOT_NUM];
+
+    // Slots are per thread unless more than SLOT_NUM threads share a lock,
+    // so a relaxed add is enough and stays uncontended.
+    static void Add(Counter& c) { c.fetch_add(1, std::memory_order_relaxed); }
+    static uint64_t Load(const Counter& c) { return c.load(std::memory_order_relaxed); }
+    static uint32_t Bucket(uint64_t ns)
+    {
+        uint32_t b = 0;
+        while(ns != 0 && b < LOCK_HIST_BUCKETS - 1){
+            ns >>= 1;
+            ++b;
+        }
+        return b;
+    }
+    Slot& ThisThreadSlot()
+    {
+        static std::atomic<uint32_t> thread_num = {0};
+        static thread_local uint32_t slot = thread_num.fetch_add(1) % SLOT_NUM;
+        return slots_[slot];
+    }
+};
+
+// Stats of a lock, nullptr if it does not record any.
+template <typename RWLock>
+auto StatsOf(RWLock& lock, int) -> decltype(lock.Stats())
+{
+    return lock.Stats();
+}
+template <typename RWLock>
+LockStats* StatsOf(RWLock&, long)
+{
+    return nullptr;
+}
+
+// Times one guard: the wait from construction to Acquired() and the hold
+// from Acquired() to Released().
+class LockTimer{
+public:
+    template <typename RWLock>
+    explicit LockTimer(RWLock& lock)
+        :stats_(StatsOf(lock, 0)), start_(stats_ != nullptr ? LockStats::Now() : 0) { }
+
+    void Acquired(LockMode mode)
+    {
+        if(stats_ != nullptr){
+            uint64_t now = LockStats::Now();
+            stats_->OnAcquire(mode, now - start_);
+            start_ = now;
+        }
+    }
+    void Upgraded()
+    {
+        if(stats_ != nullptr){
+            stats_->OnUpgrade();
+        }
+    }
+    void Released(LockMode mode)
+    {
+        if(stats_ != nullptr){
+            stats_->OnRelease(mode, LockStats::Now() - start_);
+        }
+    }
+
+private:
+    LockStats* stats_;
+    uint64_t start_;
+};
+
+}  // namespace base
+
+#endif /*__LOCK_STATS_H__*/
@@ -0,0 +1,140 @@
+#ifndef __LOCK_WAIT_H__
+#define __LOCK_WAIT_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include "rw_lock_guard.h"
+
+namespace base {
+
+static const uint32_t CACHE_LINE_SIZE = 64;
+
+// Tell the CPU we are in a spin loop (saves power, frees the sibling
+// hyper-thread and avoids the memory-order mis-speculation on loop exit).
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Exponential backoff for spin loops: every Spin() pauses twice as long as
+// the previous one (up to MAX_PAUSE_NUM pauses) and returns false once
+// MAX_SPIN_TIMES rounds have been spent, i.e. when the caller should park.
+class SpinBackoff{
+public:
+    static const uint32_t MAX_SPIN_TIMES = 10;
+    static const uint32_t MAX_PAUSE_NUM = 64;
+
+    bool Spin()
+    {
+        if(spin_times_ >= MAX_SPIN_TIMES){
+            return false;
+        }
+        for(uint32_t i = 0; i < pause_num_; ++i){
+            CpuRelax();
+        }
+        if(pause_num_ < MAX_PAUSE_NUM){
+            pause_num_ <<= 1;
+        }
+        ++spin_times_;
+        return true;
+    }
+
+    void Reset()
+    {
+        spin_times_ = 0;
+        pause_num_ = 1;
+    }
+
+private:
+    uint32_t spin_times_ = 0;
+    uint32_t pause_num_ = 1;
+};
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t),
+              "futex needs a plain 32-bit lock word");
+
+// Sleep while *addr == expected. May return spuriously, callers re-check.
+// Without futex support this degrades to a yield.
+inline void FutexWait(std::atomic<int32_t>* addr, int32_t expected)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(addr), FUTEX_WAIT_PRIVATE,
+            expected, nullptr, nullptr, 0);
+#else
+    (void)addr;
+    (void)expected;
+    std::this_thread::yield();
+#endif
+}
+
+// Like FutexWait(), but gives up at deadline. Callers re-check the clock.
+inline void FutexWaitUntil(std::atomic<int32_t>* addr, int32_t expected,
+                           const TimePoint& deadline)
+{
+    TimePoint now = std::chrono::steady_clock::now();
+    if(now >= deadline){
+        return;
+    }
+#if defined(__linux__)
+    std::chrono::nanoseconds timeout = deadline - now;
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(addr), FUTEX_WAIT_PRIVATE,
+            expected, &ts, nullptr, 0);
+#else
+    (void)addr;
+    (void)expected;
+    std::this_thread::yield();
+#endif
+}
+
+// Wake every thread sleeping in FutexWait() on addr.
+inline void FutexWakeAll(std::atomic<int32_t>* addr)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(addr), FUTEX_WAKE_PRIVATE,
+            INT32_MAX, nullptr, nullptr, 0);
+#else
+    (void)addr;
+#endif
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(int32_t),
+              "futex needs a plain 32-bit lock word");
+
+// Overloads for unsigned words, e.g. wrapping ticket counters; the kernel
+// only compares the 32 bits.
+inline void FutexWait(std::atomic<uint32_t>* addr, uint32_t expected)
+{
+    FutexWait(reinterpret_cast<std::atomic<int32_t>*>(addr),
+              static_cast<int32_t>(expected));
+}
+
+inline void FutexWaitUntil(std::atomic<uint32_t>* addr, uint32_t expected,
+                           const TimePoint& deadline)
+{
+    FutexWaitUntil(reinterpret_cast<std::atomic<int32_t>*>(addr),
+                   static_cast<int32_t>(expected), deadline);
+}
+
+inline void FutexWakeAll(std::atomic<uint32_t>* addr)
+{
+    FutexWakeAll(reinterpret_cast<std::atomic<int32_t>*>(addr));
+}
+
+}  // namespace base
+
+#endif /*__LOCK_WAIT_H__*/
@@ -0,0 +1,44 @@
+#ifndef __MUTEX_RW_LOCK_H__
+#define __MUTEX_RW_LOCK_H__
+
+#include <mutex>
+#include "rw_lock_guard.h"
+
+namespace base {
+
+// Readers and writers share one exclusive mutex. Cheaper than a real
+// readers-writer lock when almost every access is a write. The deadline
+// variants need a timed mutex such as std::timed_mutex.
+template <typename Mutex = std::mutex>
+class MutexRWLock{
+public:
+    friend ReadLockGuard<MutexRWLock>;
+    friend WriteLockGuard<MutexRWLock>;
+    friend UpgradeLockGuard<MutexRWLock>;
+
+    MutexRWLock() = default;
+
+private:
+    Mutex mutex_;
+
+    MutexRWLock(const MutexRWLock&) = delete;
+    MutexRWLock& operator=(const MutexRWLock&) = delete;
+
+    void ReadLock() { mutex_.lock(); }
+    bool TryReadLock() { return mutex_.try_lock(); }
+    bool TryReadLockUntil(const TimePoint& deadline) { return mutex_.try_lock_until(deadline); }
+    void ReadUnLock() { mutex_.unlock(); }
+
+    void WriteLock() { mutex_.lock(); }
+    bool TryWriteLock() { return mutex_.try_lock(); }
+    bool TryWriteLockUntil(const TimePoint& deadline) { return mutex_.try_lock_until(deadline); }
+    void WriteUnLock() { mutex_.unlock(); }
+
+    void UpgradeLock() { mutex_.lock(); }
+    void UpgradeUnLock() { mutex_.unlock(); }
+    void UpgradeToWriteLock() { }
+};
+
+}  // namespace base
+
+#endif /*__MUTEX_RW_LOCK_H__*/
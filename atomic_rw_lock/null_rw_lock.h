@@ -0,0 +1,39 @@
+#ifndef __NULL_RW_LOCK_H__
+#define __NULL_RW_LOCK_H__
+
+#include "rw_lock_guard.h"
+
+namespace base {
+
+// No synchronization at all. Meant for containers that are only touched by
+// one thread at a time (e.g. while being built before they are published).
+class NullRWLock{
+public:
+    friend ReadLockGuard<NullRWLock>;
+    friend WriteLockGuard<NullRWLock>;
+    friend UpgradeLockGuard<NullRWLock>;
+
+    NullRWLock() = default;
+
+private:
+    NullRWLock(const NullRWLock&) = delete;
+    NullRWLock& operator=(const NullRWLock&) = delete;
+
+    void ReadLock() { }
+    bool TryReadLock() { return true; }
+    bool TryReadLockUntil(const TimePoint&) { return true; }
+    void ReadUnLock() { }
+
+    void WriteLock() { }
+    bool TryWriteLock() { return true; }
+    bool TryWriteLockUntil(const TimePoint&) { return true; }
+    void WriteUnLock() { }
+
+    void UpgradeLock() { }
+    void UpgradeUnLock() { }
+    void UpgradeToWriteLock() { }
+};
+
+}  // namespace base
+
+#endif /*__NULL_RW_LOCK_H__*/
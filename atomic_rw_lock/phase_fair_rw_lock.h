@@ -0,0 +1,219 @@
+#ifndef __PHASE_FAIR_RW_LOCK_H__
+#define __PHASE_FAIR_RW_LOCK_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "lock_wait.h"
+#include "rw_lock_guard.h"
+
+namespace base {
+
+// Phase-fair ticket lock (PF-T, Brandenburg & Anderson). Reader and writer
+// phases alternate: a reader arriving while a writer waits or holds the lock
+// enters right after that one writer, and a writer waits at most for the
+// readers that arrived before it. Writers are served in FIFO ticket order,
+// so neither side can be starved and the worst-case wait is bounded.
+//
+// rin_ counts arrived readers in units of READER_INC, its low bits carry the
+// presence and phase id of the current writer; rout_ counts departed
+// readers; win_/wout_ are the writer ticket counters. All four are unsigned
+// and wrap around, so they are only ever compared for equality.
+//
+// The try and deadline variants cannot queue without giving up their place,
+// so they retry the non-blocking path instead and are not served in FIFO
+// order.
+class PhaseFairRWLock{
+public:
+    friend ReadLockGuard<PhaseFairRWLock>;
+    friend WriteLockGuard<PhaseFairRWLock>;
+    friend UpgradeLockGuard<PhaseFairRWLock>;
+
+    static const uint32_t READER_INC = 0x100;
+    static const uint32_t WRITER_BITS = 0x3;
+    static const uint32_t WRITER_PRESENT = 0x2;
+    static const uint32_t WRITER_PHASE_ID = 0x1;
+
+    PhaseFairRWLock() = default;
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> rin_ = {0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> rout_ = {0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> win_ = {0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> wout_ = {0};
+    std::atomic<uint32_t> park_num_ = {0};
+
+    PhaseFairRWLock(const PhaseFairRWLock&) = delete;
+    PhaseFairRWLock& operator=(const PhaseFairRWLock&) = delete;
+
+    void ReadLock();
+    bool TryReadLock();
+    bool TryReadLockUntil(const TimePoint& deadline);
+    void ReadUnLock();
+
+    void WriteLock();
+    bool TryWriteLock();
+    bool TryWriteLockUntil(const TimePoint& deadline);
+    void WriteUnLock();
+
+    // No upgradable mode, upgraders take the write lock up front.
+    void UpgradeLock() { WriteLock(); }
+    void UpgradeUnLock() { WriteUnLock(); }
+    void UpgradeToWriteLock() { }
+
+    void Wait(SpinBackoff& backoff, std::atomic<uint32_t>* word,
+              uint32_t value);
+    void WakeUp(std::atomic<uint32_t>* word);
+};
+
+
+inline void PhaseFairRWLock::Wait(SpinBackoff& backoff,
+                                  std::atomic<uint32_t>* word, uint32_t value)
+{
+    if(backoff.Spin()){
+        return;
+    }
+    park_num_.fetch_add(1);
+    FutexWait(word, value);
+    park_num_.fetch_sub(1);
+    backoff.Reset();
+}
+
+inline void PhaseFairRWLock::WakeUp(std::atomic<uint32_t>* word)
+{
+    if(park_num_.load() > 0){
+        FutexWakeAll(word);
+    }
+}
+
+inline void PhaseFairRWLock::ReadLock()
+{
+    SpinBackoff backoff;
+    uint32_t writer = rin_.fetch_add(READER_INC) & WRITER_BITS;
+    if(writer == 0){
+        return;
+    }
+    // Wait until this writer phase ends; the next writer flips the phase id.
+    uint32_t temp_rin = rin_.load();
+    while((temp_rin & WRITER_BITS) == writer){
+        Wait(backoff, &rin_, temp_rin);
+        temp_rin = rin_.load();
+    }
+}
+
+inline bool PhaseFairRWLock::TryReadLock()
+{
+    // Once counted in rin_ a reader cannot back out without confusing a
+    // waiting writer, so only enter when no writer is there.
+    uint32_t temp_rin = rin_.load();
+    do{
+        if(temp_rin & WRITER_BITS){
+            return false;
+        }
+    }while(!rin_.compare_exchange_weak(temp_rin, temp_rin + READER_INC));
+    return true;
+}
+
+inline bool PhaseFairRWLock::TryReadLockUntil(const TimePoint& deadline)
+{
+    SpinBackoff backoff;
+    while(!TryReadLock()){
+        uint32_t temp_rin = rin_.load();
+        if(!(temp_rin & WRITER_BITS)){
+            continue;
+        }
+        if(std::chrono::steady_clock::now() >= deadline){
+            return false;
+        }
+        if(!backoff.Spin()){
+            park_num_.fetch_add(1);
+            FutexWaitUntil(&rin_, temp_rin, deadline);
+            park_num_.fetch_sub(1);
+            backoff.Reset();
+        }
+    }
+    return true;
+}
+
+inline void PhaseFairRWLock::ReadUnLock()
+{
+    rout_.fetch_add(READER_INC);
+    WakeUp(&rout_);
+}
+
+inline void PhaseFairRWLock::WriteLock()
+{
+    SpinBackoff backoff;
+    uint32_t ticket = win_.fetch_add(1);
+    uint32_t temp_wout = wout_.load();
+    while(temp_wout != ticket){
+        Wait(backoff, &wout_, temp_wout);
+        temp_wout = wout_.load();
+    }
+    backoff.Reset();
+    uint32_t writer = WRITER_PRESENT | (ticket & WRITER_PHASE_ID);
+    uint32_t reader_ticket = rin_.fetch_add(writer);
+    uint32_t temp_rout = rout_.load();
+    while(temp_rout != reader_ticket){
+        Wait(backoff, &rout_, temp_rout);
+        temp_rout = rout_.load();
+    }
+}
+
+inline bool PhaseFairRWLock::TryWriteLock()
+{
+    // Only take a ticket when the lock is free: no writer holds or awaits
+    // one and every reader that came in has left.
+    uint32_t temp_rin = rin_.load();
+    if(temp_rin != rout_.load()){
+        return false;
+    }
+    uint32_t ticket = wout_.load();
+    if(!win_.compare_exchange_strong(ticket, ticket + 1)){
+        return false;
+    }
+    uint32_t writer = WRITER_PRESENT | (ticket & WRITER_PHASE_ID);
+    if(rin_.compare_exchange_strong(temp_rin, temp_rin + writer)){
+        return true;
+    }
+    // A reader came in meanwhile. The ticket still has to run a full writer
+    // phase: skipping it would give the next writer this phase id, so a
+    // reader still waiting for the previous phase of that id to end would
+    // wait for good while that writer waits for the reader.
+    rin_.fetch_add(writer);
+    WriteUnLock();
+    return false;
+}
+
+inline bool PhaseFairRWLock::TryWriteLockUntil(const TimePoint& deadline)
+{
+    SpinBackoff backoff;
+    while(!TryWriteLock()){
+        if(std::chrono::steady_clock::now() >= deadline){
+            return false;
+        }
+        if(!backoff.Spin()){
+            // Sleep on whatever changes when a reader or writer leaves.
+            uint32_t temp_rout = rout_.load();
+            park_num_.fetch_add(1);
+            FutexWaitUntil(&rout_, temp_rout,
+                           std::min(deadline, std::chrono::steady_clock::now() +
+                                                  std::chrono::milliseconds(1)));
+            park_num_.fetch_sub(1);
+            backoff.Reset();
+        }
+    }
+    return true;
+}
+
+inline void PhaseFairRWLock::WriteUnLock()
+{
+    rin_.fetch_and(~WRITER_BITS);
+    wout_.fetch_add(1);
+    WakeUp(&rin_);
+    WakeUp(&wout_);
+}
+
+}  // namespace base
+
+#endif /*__PHASE_FAIR_RW_LOCK_H__*/
@@ -1,12 +1,60 @@
 #ifndef __RW_LOCK_GUARD_H__
 #define __RW_LOCK_GUARD_H__
+
+#include <chrono>
+#include <mutex>
+#if defined(TSCONTAINER_LOCK_STATS)
+#include "lock_stats.h"
+#endif
+
+namespace base {
+
+// Deadline of the timed lock calls.
+using TimePoint = std::chrono::steady_clock::time_point;
+
+// The std::try_to_lock and deadline constructors may fail to take the
+// lock; check OwnsLock() before touching the protected data. The
+// std::adopt_lock constructor takes over a lock that is already held.
 template <typename RWLock>
 class ReadLockGuard{
 public:
-    explicit ReadLockGuard(RWLock& lock):rw_lock_(lock) { rw_lock_.ReadLock(); }
-    ~ReadLockGuard() { rw_lock_.ReadUnLock(); }
+    explicit ReadLockGuard(RWLock& lock):rw_lock_(lock)
+    {
+        rw_lock_.ReadLock();
+        Acquired();
+    }
+    ReadLockGuard(RWLock& lock, std::adopt_lock_t):rw_lock_(lock) { Acquired(); }
+    ReadLockGuard(RWLock& lock, std::try_to_lock_t)
+        :rw_lock_(lock), owns_lock_(rw_lock_.TryReadLock()) { Acquired(); }
+    ReadLockGuard(RWLock& lock, const TimePoint& deadline)
+        :rw_lock_(lock), owns_lock_(rw_lock_.TryReadLockUntil(deadline)) { Acquired(); }
+    ~ReadLockGuard()
+    {
+        if(owns_lock_){
+#if defined(TSCONTAINER_LOCK_STATS)
+            timer_.Released(LockMode::READ);
+#endif
+            rw_lock_.ReadUnLock();
+        }
+    }
+    bool OwnsLock() const { return owns_lock_; }
 private:
     RWLock& rw_lock_;
+#if defined(TSCONTAINER_LOCK_STATS)
+    // before owns_lock_, so the wait of the try and deadline variants counts
+    LockTimer timer_{rw_lock_};
+#endif
+    bool owns_lock_ = true;
+#if defined(TSCONTAINER_LOCK_STATS)
+    void Acquired()
+    {
+        if(owns_lock_){
+            timer_.Acquired(LockMode::READ);
+        }
+    }
+#else
+    void Acquired() { }
+#endif
     ReadLockGuard(const ReadLockGuard&) = delete;
     ReadLockGuard& operator=(const ReadLockGuard&) = delete;
 };
@@ -15,12 +63,91 @@ private:
 template <typename RWLock>
 class WriteLockGuard{
 public:
-    explicit WriteLockGuard(RWLock & lock):rw_lock_(lock) { rw_lock_.WriteLock(); } 
-    ~WriteLockGuard() { rw_lock_.WriteUnLock(); };
+    explicit WriteLockGuard(RWLock & lock):rw_lock_(lock)
+    {
+        rw_lock_.WriteLock();
+        Acquired();
+    }
+    WriteLockGuard(RWLock& lock, std::adopt_lock_t):rw_lock_(lock) { Acquired(); }
+    WriteLockGuard(RWLock& lock, std::try_to_lock_t)
+        :rw_lock_(lock), owns_lock_(rw_lock_.TryWriteLock()) { Acquired(); }
+    WriteLockGuard(RWLock& lock, const TimePoint& deadline)
+        :rw_lock_(lock), owns_lock_(rw_lock_.TryWriteLockUntil(deadline)) { Acquired(); }
+    ~WriteLockGuard()
+    {
+        if(owns_lock_){
+#if defined(TSCONTAINER_LOCK_STATS)
+            timer_.Released(LockMode::WRITE);
+#endif
+            rw_lock_.WriteUnLock();
+        }
+    }
+    bool OwnsLock() const { return owns_lock_; }
 private:
     RWLock& rw_lock_;
+#if defined(TSCONTAINER_LOCK_STATS)
+    // before owns_lock_, so the wait of the try and deadline variants counts
+    LockTimer timer_{rw_lock_};
+#endif
+    bool owns_lock_ = true;
+#if defined(TSCONTAINER_LOCK_STATS)
+    void Acquired()
+    {
+        if(owns_lock_){
+            timer_.Acquired(LockMode::WRITE);
+        }
+    }
+#else
+    void Acquired() { }
+#endif
     WriteLockGuard(const WriteLockGuard&) = delete;
     WriteLockGuard& operator=(const WriteLockGuard&) = delete;
 };
 
+// Holds an upgradable read lock: it shares the lock with plain readers but
+// excludes writers and other upgraders, and can turn into the write lock
+// in place with Upgrade(), so nothing read before can change meanwhile.
+template <typename RWLock>
+class UpgradeLockGuard{
+public:
+    explicit UpgradeLockGuard(RWLock& lock):rw_lock_(lock)
+    {
+        rw_lock_.UpgradeLock();
+#if defined(TSCONTAINER_LOCK_STATS)
+        timer_.Acquired(LockMode::UPGRADE);
+#endif
+    }
+    ~UpgradeLockGuard()
+    {
+#if defined(TSCONTAINER_LOCK_STATS)
+        timer_.Released(upgraded_ ? LockMode::WRITE : LockMode::READ);
+#endif
+        if(upgraded_){
+            rw_lock_.WriteUnLock();
+        }else{
+            rw_lock_.UpgradeUnLock();
+        }
+    }
+    void Upgrade()
+    {
+        if(!upgraded_){
+            rw_lock_.UpgradeToWriteLock();
+            upgraded_ = true;
+#if defined(TSCONTAINER_LOCK_STATS)
+            timer_.Upgraded();
+#endif
+        }
+    }
+private:
+    RWLock& rw_lock_;
+    bool upgraded_ = false;
+#if defined(TSCONTAINER_LOCK_STATS)
+    LockTimer timer_{rw_lock_};
+#endif
+    UpgradeLockGuard(const UpgradeLockGuard&) = delete;
+    UpgradeLockGuard& operator=(const UpgradeLockGuard&) = delete;
+};
+
+}  // namespace base
+
 #endif /*__RW_LOCK_GUARD_H__*/
\ No newline at end of file
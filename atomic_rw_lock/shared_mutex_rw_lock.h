@@ -0,0 +1,51 @@
+#ifndef __SHARED_MUTEX_RW_LOCK_H__
+#define __SHARED_MUTEX_RW_LOCK_H__
+
+#include <shared_mutex>
+#include "rw_lock_guard.h"
+
+namespace base {
+
+#if __cplusplus >= 201703L
+using DefaultSharedMutex = std::shared_mutex;
+#else
+using DefaultSharedMutex = std::shared_timed_mutex;
+#endif
+
+// Adapts a standard shared mutex to the ReadLockGuard/WriteLockGuard
+// interface. Readers never spin, they block in the mutex implementation.
+// The deadline variants need std::shared_timed_mutex.
+template <typename SharedMutex = DefaultSharedMutex>
+class SharedMutexRWLock{
+public:
+    friend ReadLockGuard<SharedMutexRWLock>;
+    friend WriteLockGuard<SharedMutexRWLock>;
+    friend UpgradeLockGuard<SharedMutexRWLock>;
+
+    SharedMutexRWLock() = default;
+
+private:
+    SharedMutex mutex_;
+
+    SharedMutexRWLock(const SharedMutexRWLock&) = delete;
+    SharedMutexRWLock& operator=(const SharedMutexRWLock&) = delete;
+
+    void ReadLock() { mutex_.lock_shared(); }
+    bool TryReadLock() { return mutex_.try_lock_shared(); }
+    bool TryReadLockUntil(const TimePoint& deadline) { return mutex_.try_lock_shared_until(deadline); }
+    void ReadUnLock() { mutex_.unlock_shared(); }
+
+    void WriteLock() { mutex_.lock(); }
+    bool TryWriteLock() { return mutex_.try_lock(); }
+    bool TryWriteLockUntil(const TimePoint& deadline) { return mutex_.try_lock_until(deadline); }
+    void WriteUnLock() { mutex_.unlock(); }
+
+    // Standard shared mutexes cannot upgrade, take them exclusively.
+    void UpgradeLock() { mutex_.lock(); }
+    void UpgradeUnLock() { mutex_.unlock(); }
+    void UpgradeToWriteLock() { }
+};
+
+}  // namespace base
+
+#endif /*__SHARED_MUTEX_RW_LOCK_H__*/
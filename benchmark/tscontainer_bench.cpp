@@ -0,0 +1,365 @@
+// Scalability benchmark of the locks and containers.
+//
+// Sweeps thread count (1, 2, 4, ... up to all cores), read/write ratio
+// (100/0, 95/5, 50/50), key count and key type (int, 24-byte string) over
+//   * tsmap and tsset (AtomicRWLock, write_first), and tsmap writing
+//     through the flat-combining combined_* methods,
+//   * tsmap behind DistRWLock, reading with read_copy,
+//   * std::map behind AtomicRWLock, write_first and read_first,
+//   * std::map behind std::shared_mutex and behind std::mutex.
+// Reads are lookups, writes alternate insert and erase of random keys, so
+// the size stays around the initial half-full table. Every operation is
+// timed; each row reports the throughput and the p50/p99/p99.9 latency.
+//
+// usage: tscontainer_bench [--ops=N] [--max-threads=N] [--keys=N,N,...]
+//                          [--impl=substring]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "atomic_rw_lock.h"
+#include "dist_rw_lock.h"
+#include "tsmap.hpp"
+#include "tsset.hpp"
+
+namespace {
+
+struct Options {
+  size_t ops = 200000;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> keys = {1000, 100000};
+  std::string impl;
+};
+
+template <class Key>
+Key make_key(uint64_t i);
+template <>
+int make_key<int>(uint64_t i) {
+  return static_cast<int>(i);
+}
+template <>
+std::string make_key<std::string>(uint64_t i) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "key-%020llu",
+                static_cast<unsigned long long>(i));
+  return buf;
+}
+
+// std::map behind base::AtomicRWLock, the way tsmap uses it, but with the
+// write_first mode selectable.
+template <class Key>
+class atomic_locked_map {
+ public:
+  explicit atomic_locked_map(bool write_first) : lock_(write_first) {}
+  bool find(const Key& k) {
+    base::ReadLockGuard<base::AtomicRWLock> rlg{lock_};
+    return map_.find(k) != map_.end();
+  }
+  void insert(const Key& k) {
+    base::WriteLockGuard<base::AtomicRWLock> wlg{lock_};
+    map_.emplace(k, 0);
+  }
+  void erase(const Key& k) {
+    base::WriteLockGuard<base::AtomicRWLock> wlg{lock_};
+    map_.erase(k);
+  }
+
+ private:
+  base::AtomicRWLock lock_;
+  std::map<Key, int> map_;
+};
+
+template <class Key>
+class shared_mutex_map {
+ public:
+  bool find(const Key& k) {
+    std::shared_lock<std::shared_mutex> sl{mtx_};
+    return map_.find(k) != map_.end();
+  }
+  void insert(const Key& k) {
+    std::unique_lock<std::shared_mutex> ul{mtx_};
+    map_.emplace(k, 0);
+  }
+  void erase(const Key& k) {
+    std::unique_lock<std::shared_mutex> ul{mtx_};
+    map_.erase(k);
+  }
+
+ private:
+  std::shared_mutex mtx_;
+  std::map<Key, int> map_;
+};
+
+template <class Key>
+class mutex_map {
+ public:
+  bool find(const Key& k) {
+    std::lock_guard<std::mutex> lg{mtx_};
+    return map_.find(k) != map_.end();
+  }
+  void insert(const Key& k) {
+    std::lock_guard<std::mutex> lg{mtx_};
+    map_.emplace(k, 0);
+  }
+  void erase(const Key& k) {
+    std::lock_guard<std::mutex> lg{mtx_};
+    map_.erase(k);
+  }
+
+ private:
+  std::mutex mtx_;
+  std::map<Key, int> map_;
+};
+
+template <class Key>
+class tsmap_adapter {
+ public:
+  bool find(const Key& k) { return map_.count(k) != 0; }
+  void insert(const Key& k) { map_.insert(std::make_pair(k, 0)); }
+  void erase(const Key& k) { map_.erase(k); }
+
+ private:
+  tscontainer::tsmap<Key, int> map_;
+};
+
+// tsmap with the writes going through the flat-combining path
+template <class Key>
+class tsmap_combined_adapter {
+ public:
+  bool find(const Key& k) { return map_.count(k) != 0; }
+  void insert(const Key& k) { map_.combined_insert(k, 0); }
+  void erase(const Key& k) { map_.combined_erase(k); }
+
+ private:
+  tscontainer::tsmap<Key, int> map_;
+};
+
+// tsmap behind DistRWLock: readers only write their own lock slot
+template <class Key>
+class tsmap_dist_adapter {
+ public:
+  bool find(const Key& k) {
+    int value;
+    return map_.read_copy(k, value);
+  }
+  void insert(const Key& k) { map_.insert(std::make_pair(k, 0)); }
+  void erase(const Key& k) { map_.erase(k); }
+
+ private:
+  tscontainer::tsmap<Key, int, std::less<Key>,
+                     std::allocator<std::pair<const Key, int>>,
+                     base::DistRWLock>
+      map_;
+};
+
+template <class Key>
+class tsset_adapter {
+ public:
+  bool find(const Key& k) { return set_.count(k) != 0; }
+  void insert(const Key& k) { set_.insert(k); }
+  void erase(const Key& k) { set_.erase(k); }
+
+ private:
+  tscontainer::tsset<Key> set_;
+};
+
+uint64_t xorshift(uint64_t& x) {
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+uint64_t percentile(const std::vector<uint32_t>& sorted, double q) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t i = static_cast<size_t>(q * (sorted.size() - 1));
+  return sorted[i];
+}
+
+// One row: threads x ops operations on a fresh, half-full table.
+template <class Key, class Map>
+void run(const char* name, const char* key_name, Map& map, size_t keys,
+         int write_pct, size_t threads, size_t ops) {
+  // pre-built keys, so building strings is not measured
+  std::vector<Key> key_pool;
+  key_pool.reserve(keys);
+  for (size_t i = 0; i < keys; i++) {
+    key_pool.push_back(make_key<Key>(i));
+  }
+  for (size_t i = 0; i < keys; i += 2) {
+    map.insert(key_pool[i]);
+  }
+  std::vector<std::vector<uint32_t>> latencies(threads);
+  std::atomic<size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::atomic<size_t> sink{0};
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      std::vector<uint32_t>& lat = latencies[t];
+      lat.resize(ops);
+      uint64_t x = 0x9e3779b97f4a7c15ull * (t + 1);
+      size_t hits = 0;
+      ready++;
+      while (!go) {
+        std::this_thread::yield();
+      }
+      for (size_t i = 0; i < ops; i++) {
+        uint64_t r = xorshift(x);
+        const Key& k = key_pool[r % keys];
+        bool write = static_cast<int>((r >> 32) % 100) < write_pct;
+        auto begin = std::chrono::steady_clock::now();
+        if (!write) {
+          hits += map.find(k) ? 1 : 0;
+        } else if ((r >> 40) & 1) {
+          map.insert(k);
+        } else {
+          map.erase(k);
+        }
+        auto end = std::chrono::steady_clock::now();
+        lat[i] = static_cast<uint32_t>(std::min<int64_t>(
+            UINT32_MAX,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                .count()));
+      }
+      sink += hits;
+    });
+  }
+  while (ready < threads) {
+    std::this_thread::yield();
+  }
+  auto begin = std::chrono::steady_clock::now();
+  go = true;
+  for (auto& w : workers) {
+    w.join();
+  }
+  double secs =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  std::vector<uint32_t> all;
+  all.reserve(threads * ops);
+  for (auto& lat : latencies) {
+    all.insert(all.end(), lat.begin(), lat.end());
+  }
+  std::sort(all.begin(), all.end());
+  std::printf("%-22s %-6s %8zu %3d/%-3d %4zu %10.2f %8llu %8llu %8llu\n", name,
+              key_name, keys, 100 - write_pct, write_pct, threads,
+              threads * ops / secs / 1e6,
+              static_cast<unsigned long long>(percentile(all, 0.5)),
+              static_cast<unsigned long long>(percentile(all, 0.99)),
+              static_cast<unsigned long long>(percentile(all, 0.999)));
+  std::fflush(stdout);
+}
+
+template <class Key>
+void sweep(const Options& opt, const char* key_name) {
+  const int write_pcts[] = {0, 5, 50};
+  // 1, 2, 4, ... and max_threads itself
+  std::vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < opt.max_threads; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(opt.max_threads);
+  auto selected = [&opt](const char* name) {
+    return opt.impl.empty() || std::strstr(name, opt.impl.c_str()) != nullptr;
+  };
+  for (size_t keys : opt.keys) {
+    for (int write_pct : write_pcts) {
+      for (size_t threads : thread_counts) {
+        if (selected("tsmap")) {
+          tsmap_adapter<Key> m;
+          run<Key>("tsmap", key_name, m, keys, write_pct, threads, opt.ops);
+        }
+        if (selected("tsmap_combined")) {
+          tsmap_combined_adapter<Key> m;
+          run<Key>("tsmap_combined", key_name, m, keys, write_pct, threads,
+                   opt.ops);
+        }
+        if (selected("tsmap_dist_read_copy")) {
+          tsmap_dist_adapter<Key> m;
+          run<Key>("tsmap_dist_read_copy", key_name, m, keys, write_pct,
+                   threads, opt.ops);
+        }
+        if (selected("tsset")) {
+          tsset_adapter<Key> m;
+          run<Key>("tsset", key_name, m, keys, write_pct, threads, opt.ops);
+        }
+        if (selected("atomic_rw_lock_wf")) {
+          atomic_locked_map<Key> m(true);
+          run<Key>("atomic_rw_lock_wf", key_name, m, keys, write_pct, threads,
+                   opt.ops);
+        }
+        if (selected("atomic_rw_lock_rf")) {
+          atomic_locked_map<Key> m(false);
+          run<Key>("atomic_rw_lock_rf", key_name, m, keys, write_pct, threads,
+                   opt.ops);
+        }
+        if (selected("shared_mutex")) {
+          shared_mutex_map<Key> m;
+          run<Key>("shared_mutex", key_name, m, keys, write_pct, threads,
+                   opt.ops);
+        }
+        if (selected("mutex")) {
+          mutex_map<Key> m;
+          run<Key>("mutex", key_name, m, keys, write_pct, threads, opt.ops);
+        }
+      }
+    }
+  }
+}
+
+bool parse(int argc, char* argv[], Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (std::strncmp(arg, "--ops=", 6) == 0) {
+      opt.ops = std::strtoull(arg + 6, nullptr, 10);
+    } else if (std::strncmp(arg, "--max-threads=", 14) == 0) {
+      opt.max_threads = std::strtoull(arg + 14, nullptr, 10);
+    } else if (std::strncmp(arg, "--keys=", 7) == 0) {
+      opt.keys.clear();
+      for (const char* p = arg + 7; *p != '\0';) {
+        char* end = nullptr;
+        opt.keys.push_back(std::strtoull(p, &end, 10));
+        p = *end == ',' ? end + 1 : end;
+        if (end == p && *p != '\0') {
+          return false;
+        }
+      }
+    } else if (std::strncmp(arg, "--impl=", 7) == 0) {
+      opt.impl = arg + 7;
+    } else {
+      return false;
+    }
+  }
+  return opt.ops > 0 && opt.max_threads > 0 && !opt.keys.empty() &&
+         std::find(opt.keys.begin(), opt.keys.end(), 0u) == opt.keys.end();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  if (!parse(argc, argv, opt)) {
+    std::fprintf(stderr,
+                 "usage: %s [--ops=N] [--max-threads=N] [--keys=N,N,...] "
+                 "[--impl=substring]\n",
+                 argv[0]);
+    return 1;
+  }
+  std::printf("%-22s %-6s %8s %7s %4s %10s %8s %8s %8s\n", "impl", "key",
+              "keys", "r/w", "thr", "Mops/s", "p50ns", "p99ns", "p99.9ns");
+  sweep<int>(opt, "int");
+  sweep<std::string>(opt, "string");
+  return 0;
+}
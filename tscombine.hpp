@@ -0,0 +1,154 @@
+#ifndef __TSCOMBINE_H__
+#define __TSCOMBINE_H__
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "lock_wait.h"
+#include "rw_lock_guard.h"
+namespace tscontainer {
+namespace detail {
+/**
+ * @brief flat_combiner, flat-combining execution of write operations
+ *
+ * A writer publishes a pointer to its operation in a cache-line-padded
+ * slot (one per thread) and then waits on that slot. Only when no combiner
+ * is active does it try to become one; the combiner takes the write lock
+ * and applies every published operation in one pass while the container
+ * stays hot in its cache, marking each done. The other writers spin on
+ * their own slot and then park on it in a futex until the combiner marks
+ * it done or hands the combiner role over. Under many writers the lock
+ * changes hands once per pass instead of once per operation, and only the
+ * combiner ever touches the lock word.
+ *
+ * @tparam Op operation, applied as apply(Op&) by the combiner
+ */
+template <class Op>
+class flat_combiner {
+ public:
+  // publication slots; more threads share slots and take turns
+  static const uint32_t SLOT_NUM = 64;
+  // passes over the slots per combining round
+  static const uint32_t COMBINE_PASSES = 2;
+
+  flat_combiner() = default;
+  flat_combiner(const flat_combiner&) = delete;
+  flat_combiner& operator=(const flat_combiner&) = delete;
+
+  /**
+   * @brief execute, returns once op has been applied, by this thread or by
+   * another combiner
+   *
+   * @tparam RWLock lock protecting the container
+   * @tparam Apply Apply
+   * @param op op
+   * @param mtx mtx
+   * @param apply called as apply(Op&) under the write lock
+   */
+  template <class RWLock, class Apply>
+  void execute(Op& op, RWLock& mtx, Apply apply) noexcept {
+    slot& s = claim();
+    s.op = &op;
+    s.state.store(POSTED, std::memory_order_release);
+    base::SpinBackoff backoff;
+    while (s.state.load(std::memory_order_acquire) != DONE) {
+      int32_t idle = 0;
+      if (combining_.load(std::memory_order_relaxed) == 0 &&
+          combining_.compare_exchange_strong(idle, 1)) {
+        {
+          base::WriteLockGuard<RWLock> wlg(mtx);
+          combine(apply);
+        }
+        combining_.store(0);
+        hand_over();
+      } else if (!backoff.Spin()) {
+        park(s);
+      }
+    }
+    s.op = nullptr;
+    s.state.store(EMPTY, std::memory_order_release);
+  }
+
+ private:
+  enum : int32_t { EMPTY, CLAIMED, POSTED, PARKED, DONE };
+  struct alignas(base::CACHE_LINE_SIZE) slot {
+    std::atomic<int32_t> state = {EMPTY};
+    Op* op = nullptr;
+  };
+
+  slot slots_[SLOT_NUM];
+  // slots [0, used_) have ever been claimed; the combiner scans only those
+  alignas(base::CACHE_LINE_SIZE) std::atomic<uint32_t> used_ = {0};
+  // 1 while a thread is the combiner
+  alignas(base::CACHE_LINE_SIZE) std::atomic<int32_t> combining_ = {0};
+
+  slot& claim() noexcept {
+    static std::atomic<uint32_t> thread_num = {0};
+    static thread_local uint32_t home = thread_num.fetch_add(1) % SLOT_NUM;
+    base::SpinBackoff backoff;
+    for (uint32_t i = home;; i = (i + 1) % SLOT_NUM) {
+      int32_t empty = EMPTY;
+      if (slots_[i].state.load(std::memory_order_relaxed) == EMPTY &&
+          slots_[i].state.compare_exchange_strong(empty, CLAIMED)) {
+        uint32_t used = used_.load();
+        while (used <= i && !used_.compare_exchange_weak(used, i + 1)) {
+        }
+        return slots_[i];
+      }
+      // every slot is busy: back off before the next round
+      if ((i + 1) % SLOT_NUM == home && !backoff.Spin()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  // Sleep on s until it is done or the combiner role is handed over.
+  void park(slot& s) noexcept {
+    int32_t posted = POSTED;
+    if (!s.state.compare_exchange_strong(posted, PARKED)) {
+      return;
+    }
+    // Pairs with hand_over(): either we see the combiner gone, or it sees
+    // us parked and wakes us.
+    if (combining_.load() == 0) {
+      int32_t parked = PARKED;
+      s.state.compare_exchange_strong(parked, POSTED);
+      return;
+    }
+    base::FutexWait(&s.state, PARKED);
+  }
+  // The combiner left: wake one parked writer to take over, the others
+  // are served by it.
+  void hand_over() noexcept {
+    uint32_t used = used_.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < used; i++) {
+      int32_t parked = PARKED;
+      if (slots_[i].state.compare_exchange_strong(parked, POSTED)) {
+        base::FutexWakeAll(&slots_[i].state);
+        return;
+      }
+    }
+  }
+  template <class Apply>
+  void combine(Apply& apply) noexcept {
+    for (uint32_t pass = 0; pass < COMBINE_PASSES; pass++) {
+      bool applied = false;
+      uint32_t used = used_.load(std::memory_order_acquire);
+      for (uint32_t i = 0; i < used; i++) {
+        slot& s = slots_[i];
+        int32_t state = s.state.load(std::memory_order_acquire);
+        if (state == POSTED || state == PARKED) {
+          apply(*s.op);
+          if (s.state.exchange(DONE) == PARKED) {
+            base::FutexWakeAll(&s.state);
+          }
+          applied = true;
+        }
+      }
+      if (!applied) {
+        break;
+      }
+    }
+  }
+};
+}  // namespace detail
+}  // namespace tscontainer
+#endif  // __TSCOMBINE_H__
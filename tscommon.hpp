@@ -0,0 +1,107 @@
+#ifndef __TSCOMMON_H__
+#define __TSCOMMON_H__
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <map>
+namespace tscontainer {
+/**
+ * @brief result of the non-blocking try_* operations
+ *
+ */
+enum class try_status {
+  // the lock was taken and the operation ran
+  done,
+  // the lock was busy, nothing was done
+  would_block
+};
+/**
+ * @brief kind of one operation of apply_batch
+ *
+ */
+enum class batch_op {
+  // insert if missing, result: inserted
+  insert,
+  // insert or overwrite, result: inserted, false if overwritten
+  assign,
+  // erase, result: erased
+  erase
+};
+/**
+ * @brief hash_partition, default key-to-shard mapping of the sharded
+ * containers; a key goes to shard hash(key) % ShardNum
+ *
+ * A key-range partition is any functor returning the shard index directly,
+ * growing with the key; call_each then visits keys in order.
+ *
+ * @tparam Key key
+ * @tparam Hash hash
+ */
+template <class Key, class Hash = std::hash<Key>>
+struct hash_partition {
+  std::size_t operator()(const Key& k) const noexcept { return Hash()(k); }
+};
+
+namespace detail {
+// lookups descending a tree together in group_lower_bound
+const std::size_t DESCENT_GROUP = 8;
+
+/**
+ * @brief group_lower_bound, out[g] = tree.lower_bound(*keys[g]) for up to
+ * DESCENT_GROUP keys
+ *
+ * With libstdc++ the descents advance in lock step through the red-black
+ * tree: every round moves each of them one level down and prefetches the
+ * node it moved to, so the cache misses of the group overlap instead of
+ * following one another. Elsewhere it calls lower_bound per key.
+ *
+ * @tparam Tree std::map or std::set, possibly const
+ * @tparam KeyOf key of a value_type
+ * @param out out
+ */
+template <class Tree, class Key, class KeyOf, class Comp, class It>
+void group_lower_bound(Tree& tree, const Key* const* keys, std::size_t m,
+                       KeyOf key_of, Comp comp, It* out) noexcept {
+#if defined(__GLIBCXX__)
+  using value_type = typename std::iterator_traits<It>::value_type;
+  using node = std::_Rb_tree_node<value_type>;
+  auto header = tree.end()._M_node;
+  decltype(header) x[DESCENT_GROUP];
+  decltype(header) y[DESCENT_GROUP];
+  for (std::size_t g = 0; g < m; g++) {
+    x[g] = header->_M_parent;
+    y[g] = header;
+  }
+  for (bool active = true; active;) {
+    active = false;
+    for (std::size_t g = 0; g < m; g++) {
+      if (x[g] == nullptr) {
+        continue;
+      }
+      const value_type& v = *static_cast<const node*>(x[g])->_M_valptr();
+      if (!comp(key_of(v), *keys[g])) {
+        y[g] = x[g];
+        x[g] = x[g]->_M_left;
+      } else {
+        x[g] = x[g]->_M_right;
+      }
+      if (x[g] != nullptr) {
+        __builtin_prefetch(x[g]);
+        active = true;
+      }
+    }
+  }
+  for (std::size_t g = 0; g < m; g++) {
+    out[g] = It(y[g]);
+  }
+#else
+  (void)key_of;
+  (void)comp;
+  for (std::size_t g = 0; g < m; g++) {
+    out[g] = tree.lower_bound(*keys[g]);
+  }
+#endif
+}
+}  // namespace detail
+}  // namespace tscontainer
+#endif  // __TSCOMMON_H__
@@ -0,0 +1,1203 @@
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+#include "co_rw_lock.h"
+#include "dist_rw_lock.h"
+#include "mutex_rw_lock.h"
+#include "null_rw_lock.h"
+#include "phase_fair_rw_lock.h"
+#include "shared_mutex_rw_lock.h"
+#include "tscowmap.hpp"
+#include "tsflatmap.hpp"
+#include "tsflatset.hpp"
+#include "tshashmap.hpp"
+#include "tshashset.hpp"
+#include "tsintset.hpp"
+#include "tsskipmap.hpp"
+#include "tsskipset.hpp"
+#include "tsmap.hpp"
+#include "tspool.hpp"
+#include "tsset.hpp"
+#include "tsshardedmap.hpp"
+#include "tsshardedset.hpp"
+#include <gtest/gtest.h>
+
+template <typename RWLock>
+using IntMap = tscontainer::tsmap<int, int, std::less<int>,
+                                  std::allocator<std::pair<const int, int>>,
+                                  RWLock>;
+
+template <typename RWLock>
+using IntSet =
+    tscontainer::tsset<int, std::less<int>, std::allocator<int>, RWLock>;
+
+template <typename RWLock>
+class LockPolicyTest : public ::testing::Test {};
+
+using LockPolicies =
+    ::testing::Types<base::AtomicRWLock, base::DistRWLock,
+                     base::PhaseFairRWLock, base::MutexRWLock<>,
+                     base::SharedMutexRWLock<>
+#if defined(__cpp_impl_coroutine)
+                     , base::CoRWLock
+#endif
+                     >;
+TYPED_TEST_SUITE(LockPolicyTest, LockPolicies);
+
+TYPED_TEST(LockPolicyTest, map_concurrent_insert) {
+  IntMap<TypeParam> map;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&map, t]() {
+      for (int i = 0; i < 1000; i++) {
+        map.insert(std::make_pair(t * 1000 + i, i));
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(4000u, map.size());
+  int sum = 0;
+  map.call_each(
+      [&sum](const std::pair<const int, int>& p) { sum += p.second; });
+  EXPECT_EQ(4 * 999 * 1000 / 2, sum);
+}
+
+TYPED_TEST(LockPolicyTest, set_concurrent_insert) {
+  IntSet<TypeParam> set;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&set, t]() {
+      for (int i = 0; i < 1000; i++) set.insert(t * 1000 + i);
+    });
+  }
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(4000u, set.size());
+  EXPECT_EQ(1u, set.count(3999));
+  EXPECT_EQ(1u, set.erase(3999));
+  EXPECT_EQ(0u, set.count(3999));
+}
+
+TYPED_TEST(LockPolicyTest, map_find_or_emplace) {
+  IntMap<TypeParam> map;
+  std::atomic<int> inserted(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&map, &inserted, t]() {
+      for (int i = 0; i < 1000; i++) {
+        auto res = map.find_or_emplace(i, t);
+        if (res.second) inserted++;
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(1000, inserted.load());
+  EXPECT_EQ(1000u, map.size());
+  EXPECT_FALSE(map.find_or_insert(std::make_pair(1, 42)).second);
+  EXPECT_TRUE(map.find_or_insert(std::make_pair(1000, 42)).second);
+  EXPECT_EQ(42, map.at(1000));
+  map[2000] = 7;
+  EXPECT_EQ(7, map[2000]);
+  EXPECT_EQ(1002u, map.size());
+}
+
+TYPED_TEST(LockPolicyTest, sharded_concurrent_insert) {
+  tscontainer::tsshardedmap<int, int, 8, tscontainer::hash_partition<int>,
+                            std::less<int>,
+                            std::allocator<std::pair<const int, int>>,
+                            TypeParam>
+      map;
+  tscontainer::tsshardedset<int, 8, tscontainer::hash_partition<int>,
+                            std::less<int>, std::allocator<int>, TypeParam>
+      set;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&map, &set, t]() {
+      for (int i = 0; i < 1000; i++) {
+        map.insert(std::make_pair(t * 1000 + i, i));
+        EXPECT_FALSE(map.find_or_emplace(t * 1000 + i, -1).second);
+        set.insert(t * 1000 + i);
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(4000u, map.size());
+  EXPECT_EQ(4000u, set.size());
+  int sum = 0;
+  map.call_each(
+      [&sum](const std::pair<const int, int>& p) { sum += p.second; });
+  EXPECT_EQ(4 * 999 * 1000 / 2, sum);
+  int value = 0;
+  EXPECT_TRUE(map.read_copy(3999, value));
+  EXPECT_EQ(999, value);
+  EXPECT_EQ(1u, map.erase(3999));
+  EXPECT_EQ(1u, set.erase(3999));
+  EXPECT_EQ(3999u, map.size());
+  EXPECT_EQ(0u, set.count(3999));
+  EXPECT_FALSE(map.find(3999).second);
+  EXPECT_FALSE(set.find(3999).second);
+  map[3999] = 7;
+  EXPECT_EQ(7, map[3999]);
+  auto found = map.find(3999);
+  ASSERT_TRUE(found.second);
+  EXPECT_EQ(7, found.first->second);
+  EXPECT_EQ(7, map.at(3999));
+  EXPECT_EQ(3998, *set.find(3998).first);
+  map.clear();
+  set.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(set.empty());
+}
+
+TYPED_TEST(LockPolicyTest, hash_concurrent_insert) {
+  tscontainer::tshashmap<int, int, std::hash<int>, std::equal_to<int>,
+                         std::allocator<std::pair<const int, int>>, TypeParam,
+                         4>
+      map;
+  tscontainer::tshashset<int, std::hash<int>, std::equal_to<int>,
+                         std::allocator<int>, TypeParam, 4>
+      set;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&map, &set, t]() {
+      for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(map.insert(std::make_pair(t * 1000 + i, i)));
+        EXPECT_FALSE(map.find_or_emplace(t * 1000 + i, -1).second);
+        EXPECT_TRUE(set.insert(t * 1000 + i));
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(4000u, map.size());
+  EXPECT_EQ(4000u, set.size());
+  int sum = 0;
+  map.call_each(
+      [&sum](const std::pair<const int, int>& p) { sum += p.second; });
+  EXPECT_EQ(4 * 999 * 1000 / 2, sum);
+  for (int k = 0; k < 4000; k++) {
+    int value = -1;
+    ASSERT_TRUE(map.read_copy(k, value));
+    EXPECT_EQ(k % 1000, value);
+    ASSERT_EQ(1u, set.count(k));
+  }
+  EXPECT_EQ(1u, map.erase(3999));
+  EXPECT_EQ(0u, map.erase(3999));
+  EXPECT_EQ(1u, set.erase(3999));
+  EXPECT_EQ(3999u, map.size());
+  EXPECT_EQ(0u, set.count(3999));
+  map[3999] = 7;
+  EXPECT_EQ(7, map[3999]);
+  map.clear();
+  set.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(set.empty());
+  EXPECT_TRUE(set.insert(1));
+  EXPECT_EQ(1u, set.count(1));
+}
+
+TYPED_TEST(LockPolicyTest, flat_concurrent_insert) {
+  tscontainer::tsflatmap<int, int, std::less<int>,
+                         std::allocator<std::pair<int, int>>, TypeParam>
+      map;
+  tscontainer::tsflatset<int, std::less<int>, std::allocator<int>, TypeParam>
+      set;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&map, &set, t]() {
+      for (int i = 0; i < 500; i++) {
+        EXPECT_TRUE(map.insert(std::make_pair(i * 4 + t, i)));
+        EXPECT_FALSE(map.find_or_emplace(i * 4 + t, -1));
+        EXPECT_TRUE(set.insert(i * 4 + t));
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(2000u, map.size());
+  EXPECT_EQ(2000u, set.size());
+  int prev = -1;
+  map.call_each([&prev](const std::pair<int, int>& p) {
+    EXPECT_EQ(prev + 1, p.first);
+    prev = p.first;
+  });
+  int sum = 0;
+  set.call_range(10, 20, [&sum](int k) { sum += k; });
+  EXPECT_EQ(145, sum);
+  EXPECT_EQ(1u, map.erase(7));
+  EXPECT_EQ(0u, map.count(7));
+  EXPECT_FALSE(map.upsert(8, 80));
+  EXPECT_TRUE(map.upsert(7, 70));
+  EXPECT_EQ(70, map.get(7).value());
+  EXPECT_TRUE(map.visit(8, [](const int& v) { EXPECT_EQ(80, v); }));
+  EXPECT_FALSE(map.visit(-1, [](const int&) { FAIL(); }));
+  EXPECT_EQ(1u, set.erase(7));
+  EXPECT_EQ(0u, set.count(7));
+}
+
+TYPED_TEST(LockPolicyTest, apply_batch) {
+  IntMap<TypeParam> map;
+  IntSet<TypeParam> set;
+  for (int i = 0; i < 100; i += 2) {
+    map.insert(std::make_pair(i, i));
+    set.insert(i);
+  }
+  using map_entry = typename IntMap<TypeParam>::batch_entry;
+  using set_entry = typename IntSet<TypeParam>::batch_entry;
+  std::vector<map_entry> map_ops;
+  std::vector<set_entry> set_ops;
+  for (int i = 99; i >= 0; i--) {
+    tscontainer::batch_op op = i % 3 == 0   ? tscontainer::batch_op::erase
+                               : i % 3 == 1 ? tscontainer::batch_op::insert
+                                            : tscontainer::batch_op::assign;
+    map_ops.push_back(map_entry{op, i, -i});
+    set_ops.push_back(set_entry{op, i});
+  }
+  // same key twice: the later operation sees the earlier one
+  map_ops.push_back(map_entry{tscontainer::batch_op::insert, 0, 7});
+  std::unique_ptr<bool[]> map_res(new bool[map_ops.size()]());
+  std::unique_ptr<bool[]> set_res(new bool[set_ops.size()]());
+  size_t map_done =
+      map.apply_batch(map_ops.data(), map_ops.size(), map_res.get());
+  set.apply_batch(set_ops.data(), set_ops.size(), set_res.get());
+  size_t expected_done = 0;
+  for (size_t j = 0; j < 100; j++) {
+    int i = 99 - static_cast<int>(j);
+    bool present = i % 2 == 0;
+    bool expected = i % 3 == 0 ? present : i % 3 == 1 ? !present : !present;
+    EXPECT_EQ(expected, map_res[j]) << i;
+    EXPECT_EQ(expected, set_res[j]) << i;
+    expected_done += expected ? 1 : 0;
+    if (i != 0) {
+      EXPECT_EQ(i % 3 == 0 ? 0u : 1u, map.count(i)) << i;
+    }
+    EXPECT_EQ(i % 3 == 0 ? 0u : 1u, set.count(i)) << i;
+    if (i % 3 == 2) {
+      EXPECT_EQ(-i, map.at(i));
+    }
+    if (i % 3 == 1) {
+      EXPECT_EQ(present ? i : -i, map.at(i));
+    }
+  }
+  EXPECT_TRUE(map_res[100]);
+  EXPECT_EQ(expected_done + 1, map_done);
+  EXPECT_EQ(7, map.at(0));
+}
+
+TYPED_TEST(LockPolicyTest, lookup_many) {
+  IntMap<TypeParam> map;
+  IntSet<TypeParam> set;
+  for (int i = 0; i < 1000; i += 3) {
+    map.insert(std::make_pair(i, -i));
+    set.insert(i);
+  }
+  // unsorted, with duplicates and more keys than one sort block
+  std::vector<int> keys;
+  for (int i = 0; i < 300; i++) {
+    keys.push_back((i * 7919) % 1100);
+  }
+  keys.push_back(keys.front());
+  size_t n = keys.size();
+  std::vector<typename IntMap<TypeParam>::iterator> its(n);
+  std::vector<typename IntSet<TypeParam>::const_iterator> set_its(n);
+  std::vector<int> values(n, 1);
+  std::unique_ptr<bool[]> map_found(new bool[n]());
+  std::unique_ptr<bool[]> set_found(new bool[n]());
+  std::unique_ptr<bool[]> got(new bool[n]());
+  size_t hits = map.find_many(keys.data(), n, its.data());
+  EXPECT_EQ(hits, map.count_many(keys.data(), n, map_found.get()));
+  EXPECT_EQ(hits, map.get_many(keys.data(), n, values.data(), got.get()));
+  EXPECT_EQ(hits, set.count_many(keys.data(), n, set_found.get()));
+  EXPECT_EQ(hits, set.find_many(keys.data(), n, set_its.data()));
+  size_t expected_hits = 0;
+  for (size_t i = 0; i < n; i++) {
+    bool present = keys[i] < 1000 && keys[i] % 3 == 0;
+    expected_hits += present ? 1 : 0;
+    EXPECT_EQ(present, map_found[i]) << keys[i];
+    EXPECT_EQ(present, set_found[i]) << keys[i];
+    EXPECT_EQ(present, got[i]) << keys[i];
+    EXPECT_EQ(present ? -keys[i] : 1, values[i]) << keys[i];
+    if (present) {
+      EXPECT_EQ(keys[i], its[i]->first);
+      EXPECT_EQ(keys[i], *set_its[i]);
+    } else {
+      EXPECT_TRUE(its[i] == map.end());
+      EXPECT_TRUE(set_its[i] == set.end());
+    }
+  }
+  EXPECT_EQ(expected_hits, hits);
+  EXPECT_EQ(0u, map.count_many(keys.data(), 0, map_found.get()));
+}
+
+TYPED_TEST(LockPolicyTest, value_accessors) {
+  IntMap<TypeParam> map;
+  EXPECT_FALSE(map.get(1).has_value());
+  EXPECT_EQ(-1, map.get_or(1, -1));
+  EXPECT_TRUE(map.upsert(1, 10));
+  EXPECT_FALSE(map.upsert(1, 11));
+  EXPECT_EQ(11, map.get(1).value());
+  EXPECT_EQ(11, map.get_or(1, -1));
+  EXPECT_FALSE(map.compute_if_present(2, [](int& v) { v++; }));
+  EXPECT_EQ(0u, map.count(2));
+  EXPECT_TRUE(map.compute(2, [](int& v) { v += 5; }));
+  EXPECT_FALSE(map.compute(2, [](int& v) { v += 5; }));
+  EXPECT_TRUE(map.compute_if_present(2, [](int& v) { v *= 2; }));
+  EXPECT_EQ(20, map.get_or(2, -1));
+  EXPECT_FALSE(map.erase_if(2, [](const int& v) { return v < 0; }));
+  EXPECT_TRUE(map.erase_if(2, [](const int& v) { return v == 20; }));
+  EXPECT_FALSE(map.erase_if(2, [](const int&) { return true; }));
+  EXPECT_EQ(1u, map.size());
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&map]() {
+      for (int i = 0; i < 1000; i++) {
+        map.compute(i % 10, [](int& v) { v++; });
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  int sum = 0;
+  for (int i = 0; i < 10; i++) {
+    sum += map.get_or(i, 0);
+  }
+  EXPECT_EQ(11 + 4000, sum);
+}
+
+TYPED_TEST(LockPolicyTest, combined_writes) {
+  IntMap<TypeParam> map;
+  std::vector<std::thread> threads;
+  std::atomic<int> inserted{0}, erased{0};
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&map, &inserted, &erased, t]() {
+      for (int i = 0; i < 500; i++) {
+        int k = t * 1000 + i;
+        inserted += map.combined_insert(k, k) ? 1 : 0;
+        EXPECT_FALSE(map.combined_insert(k, -1));
+        if (i % 2 == 0) {
+          erased += map.combined_erase(k) ? 1 : 0;
+        } else {
+          EXPECT_FALSE(map.combined_assign(k, -k));
+        }
+        // plain writers mix with combined ones
+        map.insert(std::make_pair(100000 + k, 0));
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  EXPECT_EQ(4000, inserted.load());
+  EXPECT_EQ(2000, erased.load());
+  EXPECT_EQ(2000u + 4000u, map.size());
+  for (int t = 0; t < 8; t++) {
+    for (int i = 0; i < 500; i++) {
+      int k = t * 1000 + i;
+      EXPECT_EQ(i % 2 == 0 ? -1 : -k, map.get_or(k, -1));
+    }
+  }
+  EXPECT_FALSE(map.combined_erase(-5));
+  EXPECT_TRUE(map.combined_assign(-5, 5));
+  EXPECT_EQ(5, map.get_or(-5, 0));
+}
+
+struct Stats {
+  int hits;
+  int misses;
+};
+
+TYPED_TEST(LockPolicyTest, map_read_copy) {
+  tscontainer::tsmap<int, Stats, std::less<int>,
+                     std::allocator<std::pair<const int, Stats>>, TypeParam>
+      map;
+  map.insert(std::make_pair(0, Stats{0, 0}));
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; t++) {
+    readers.emplace_back([&map, &stop]() {
+      Stats stats;
+      while (!stop.load()) {
+        if (map.read_copy(0, stats)) {
+          EXPECT_EQ(stats.hits, -stats.misses);
+        }
+      }
+    });
+  }
+  for (int i = 1; i <= 1000; i++) {
+    map.erase(0);
+    map.insert(std::make_pair(0, Stats{i, -i}));
+  }
+  stop = true;
+  for (auto& th : readers) th.join();
+  Stats stats{0, 0};
+  EXPECT_TRUE(map.read_copy(0, stats));
+  EXPECT_EQ(1000, stats.hits);
+  EXPECT_FALSE(map.read_copy(1, stats));
+  EXPECT_EQ(1000, stats.hits);
+}
+
+TYPED_TEST(LockPolicyTest, try_operations) {
+  IntMap<TypeParam> map;
+  IntSet<TypeParam> set;
+  std::pair<typename IntMap<TypeParam>::iterator, bool> map_res;
+  std::pair<typename IntSet<TypeParam>::iterator, bool> set_res;
+  EXPECT_EQ(tscontainer::try_status::done,
+            map.try_insert(std::make_pair(1, 1), map_res));
+  EXPECT_TRUE(map_res.second);
+  EXPECT_EQ(tscontainer::try_status::done, set.try_insert(1, set_res));
+  EXPECT_TRUE(set_res.second);
+  // The read lock held by call_each makes every writer wait.
+  map.call_each([&](const std::pair<const int, int>&) {
+    std::thread([&]() {
+      EXPECT_EQ(tscontainer::try_status::would_block,
+                map.try_insert(std::make_pair(2, 2), map_res));
+      size_t count = 0;
+      EXPECT_EQ(tscontainer::try_status::would_block, map.try_erase(1, count));
+    }).join();
+  });
+  set.call_each([&](int) {
+    std::thread([&]() {
+      EXPECT_EQ(tscontainer::try_status::would_block,
+                set.try_insert(2, set_res));
+    }).join();
+  });
+  typename IntMap<TypeParam>::iterator it;
+  EXPECT_EQ(tscontainer::try_status::done, map.try_find(1, it));
+  EXPECT_EQ(1, it->second);
+  typename IntSet<TypeParam>::const_iterator cit;
+  EXPECT_EQ(tscontainer::try_status::done, set.try_find(2, cit));
+  size_t count = 0;
+  EXPECT_EQ(tscontainer::try_status::done, set.try_erase(1, count));
+  EXPECT_EQ(1u, count);
+}
+
+#if defined(__cpp_impl_coroutine)
+// Fire-and-forget coroutine, the frame goes away when it finishes.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Manually driven executor.
+struct QueueExecutor {
+  std::deque<std::coroutine_handle<>> queue;
+  base::CoRWLock::Executor executor() {
+    return [this](std::coroutine_handle<> h) { queue.push_back(h); };
+  }
+  void run() {
+    while (!queue.empty()) {
+      auto h = queue.front();
+      queue.pop_front();
+      h.resume();
+    }
+  }
+};
+
+struct Yield {
+  QueueExecutor& executor;
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> h) { executor.queue.push_back(h); }
+  void await_resume() {}
+};
+
+TEST(CoRWLockTest, contention_suspends) {
+  QueueExecutor executor;
+  base::CoRWLock lock(executor.executor());
+  std::vector<int> order;
+  auto writer = [&]() -> DetachedTask {
+    auto guard = co_await lock.Write();
+    order.push_back(1);
+    co_await Yield{executor};
+    order.push_back(2);
+  };
+  auto reader = [&](int id) -> DetachedTask {
+    auto guard = co_await lock.Read();
+    order.push_back(id);
+  };
+  writer();
+  // Both readers suspend behind the writer, the thread keeps going.
+  reader(3);
+  reader(4);
+  EXPECT_EQ(std::vector<int>({1}), order);
+  executor.run();
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), order);
+  // Threads share the queue with coroutines.
+  base::WriteLockGuard<base::CoRWLock> lg(lock);
+}
+
+TEST(CoRWLockTest, async_map) {
+  using CoMap =
+      tscontainer::tsmap<int, int, std::less<int>,
+                         std::allocator<std::pair<const int, int>>,
+                         base::CoRWLock>;
+  CoMap map;
+  bool done = false;
+  auto task = [&]() -> DetachedTask {
+    auto res = co_await map.async_insert(std::make_pair(1, 10));
+    EXPECT_TRUE(res.second);
+    auto it = co_await map.async_find(1);
+    EXPECT_EQ(10, it->second);
+    done = true;
+  };
+  map.insert(std::make_pair(0, 0));
+  map.call_each([&](const std::pair<const int, int>&) {
+    // The read lock is held: the insert suspends until call_each returns.
+    task();
+    EXPECT_FALSE(done);
+  });
+  EXPECT_TRUE(done);
+  EXPECT_EQ(2u, map.size());
+}
+
+TEST(CoRWLockTest, async_insert_feed) {
+  using CoMap =
+      tscontainer::tsmap<int, int, std::less<int>,
+                         std::allocator<std::pair<const int, int>>,
+                         base::CoRWLock>;
+  using CoSet = tscontainer::tsset<int, std::less<int>, std::allocator<int>,
+                                   base::CoRWLock>;
+  CoMap map;
+  CoSet set;
+  auto map_sub = map.subscribe();
+  auto set_sub = set.subscribe();
+  auto task = [&]() -> DetachedTask {
+    co_await map.async_insert(std::make_pair(1, 10));
+    // Not inserted, not published.
+    co_await map.async_insert(std::make_pair(1, 11));
+    co_await set.async_insert(2);
+  };
+  task();
+  std::vector<tscontainer::change_event<int, int>> map_events;
+  EXPECT_EQ(1u, map_sub.poll(8, std::back_inserter(map_events)));
+  EXPECT_EQ(tscontainer::change_op::insert, map_events[0].op);
+  EXPECT_EQ(1, map_events[0].key);
+  EXPECT_EQ(10, map_events[0].value);
+  std::vector<tscontainer::change_event<int, void>> set_events;
+  EXPECT_EQ(1u, set_sub.poll(8, std::back_inserter(set_events)));
+  EXPECT_EQ(tscontainer::change_op::insert, set_events[0].op);
+  EXPECT_EQ(2, set_events[0].key);
+}
+#endif
+
+struct DecadePartition {
+  size_t operator()(int k) const noexcept { return k / 10; }
+};
+
+TEST(ShardedMapTest, string_values) {
+  tscontainer::tsshardedmap<int, std::string> map;
+  EXPECT_TRUE(map.emplace(1, "one").second);
+  EXPECT_FALSE(map.emplace(1, "uno").second);
+  EXPECT_FALSE(map.get(2).has_value());
+  EXPECT_EQ("one", map.get(1).value());
+  size_t len = 0;
+  EXPECT_TRUE(map.visit(1, [&len](const std::string& v) { len = v.size(); }));
+  EXPECT_EQ(3u, len);
+  EXPECT_FALSE(map.visit(2, [&len](const std::string&) { len = 0; }));
+  EXPECT_EQ(3u, len);
+}
+
+TEST(HashMapTest, string_values) {
+  tscontainer::tshashmap<int, std::string> map;
+  EXPECT_TRUE(map.insert(std::make_pair(1, std::string("one"))));
+  EXPECT_FALSE(map.get(2).has_value());
+  EXPECT_EQ("one", map.get(1).value());
+  size_t len = 0;
+  EXPECT_TRUE(map.visit(1, [&len](const std::string& v) { len = v.size(); }));
+  EXPECT_EQ(3u, len);
+  EXPECT_FALSE(map.visit(2, [&len](const std::string&) { len = 0; }));
+  EXPECT_EQ(3u, len);
+}
+
+TEST(ShardedSetTest, range_partition_in_order) {
+  tscontainer::tsshardedset<int, 10, DecadePartition> set;
+  for (int i = 99; i >= 0; i--) set.insert(i);
+  std::vector<int> keys;
+  set.call_each([&keys](int k) { keys.push_back(k); });
+  ASSERT_EQ(100u, keys.size());
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+TEST(SkipListTest, ordered_lookups) {
+  tscontainer::tsskipmap<int, int> map;
+  for (int i = 0; i < 100; i += 2) {
+    EXPECT_TRUE(map.insert(std::make_pair(i, -i)).second);
+  }
+  EXPECT_FALSE(map.find_or_emplace(10, 1).second);
+  EXPECT_EQ(50u, map.size());
+  auto guard = map.pin();
+  EXPECT_EQ(map.end(), map.find(11));
+  EXPECT_EQ(-10, map.find(10)->second);
+  EXPECT_EQ(12, map.lower_bound(11)->first);
+  EXPECT_EQ(12, map.upper_bound(10)->first);
+  EXPECT_EQ(map.end(), map.lower_bound(99));
+  auto range = map.equal_range(20);
+  EXPECT_EQ(20, range.first->first);
+  EXPECT_EQ(22, range.second->first);
+  int n = 0;
+  for (auto it = map.lower_bound(10); it != map.upper_bound(20); ++it) n++;
+  EXPECT_EQ(6, n);
+  EXPECT_EQ(1u, map.erase(10));
+  EXPECT_EQ(0u, map.erase(10));
+  EXPECT_EQ(0u, map.count(10));
+  int value = 0;
+  EXPECT_TRUE(map.read_copy(12, value));
+  EXPECT_EQ(-12, value);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.end(), map.begin());
+}
+
+TEST(SkipListTest, scans_alongside_writers) {
+  tscontainer::tsskipset<int> set;
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&set, &stop]() {
+      while (!stop.load()) {
+        int prev = -1;
+        set.call_each([&prev](int k) {
+          EXPECT_LT(prev, k);
+          prev = k;
+        });
+      }
+    });
+  }
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; t++) {
+    writers.emplace_back([&set, t]() {
+      for (int round = 0; round < 5; round++) {
+        for (int i = t; i < 2000; i += 4) EXPECT_TRUE(set.insert(i).second);
+        for (int i = t; i < 2000; i += 4) {
+          if (i % 2 == 0 || round < 4) {
+            EXPECT_EQ(1u, set.erase(i));
+          }
+        }
+      }
+    });
+  }
+  for (auto& th : writers) th.join();
+  stop = true;
+  for (auto& th : threads) th.join();
+  EXPECT_EQ(1000u, set.size());
+  auto guard = set.pin();
+  EXPECT_EQ(1, *set.begin());
+  EXPECT_EQ(1u, set.count(1999));
+  EXPECT_EQ(0u, set.count(1998));
+}
+
+TEST(FlatMapTest, bulk_assign) {
+  std::vector<std::pair<int, int>> rows;
+  for (int i = 999; i >= 0; i--) rows.emplace_back(i % 500, i);
+  tscontainer::tsflatmap<int, int> map(rows.begin(), rows.end());
+  // duplicates keep the first occurrence
+  EXPECT_EQ(500u, map.size());
+  int value = 0;
+  EXPECT_TRUE(map.read_copy(0, value));
+  EXPECT_EQ(500, value);
+  map.assign(rows.begin(), rows.begin() + 10);
+  EXPECT_EQ(10u, map.size());
+  EXPECT_EQ(0u, map.count(489));
+  EXPECT_EQ(1u, map.count(490));
+  int n = 0;
+  map.call_range(495, 1000, [&n](const std::pair<int, int>&) { n++; });
+  EXPECT_EQ(5, n);
+  map.call_range(1000, 0, [&n](const std::pair<int, int>&) { n++; });
+  EXPECT_EQ(5, n);
+}
+
+TEST(IntSetTest, array_and_bitmap_chunks) {
+  tscontainer::tsintset<uint32_t> set;
+  std::set<uint32_t> ref;
+  // a sparse chunk stays an array, a dense one becomes a bitmap
+  for (uint32_t i = 0; i < 3000; i++) {
+    EXPECT_TRUE(set.insert(i * 7));
+    ref.insert(i * 7);
+  }
+  std::vector<uint32_t> dense;
+  for (uint32_t i = 0; i < 20000; i++) dense.push_back((1u << 20) + i * 3);
+  EXPECT_EQ(20000u, set.insert_many(dense.begin(), dense.end()));
+  EXPECT_EQ(0u, set.insert_many(dense.begin(), dense.end()));
+  ref.insert(dense.begin(), dense.end());
+  EXPECT_FALSE(set.insert(7));
+  EXPECT_EQ(ref.size(), set.size());
+  std::vector<uint32_t> probe;
+  for (uint32_t v = 0; v < (1u << 20) + 70000; v += 5) probe.push_back(v);
+  std::unique_ptr<bool[]> found(new bool[probe.size()]());
+  size_t hits = set.count_many(probe.data(), probe.size(), found.get());
+  size_t expected = 0;
+  for (size_t i = 0; i < probe.size(); i++) {
+    ASSERT_EQ(ref.count(probe[i]) != 0, found[i]) << probe[i];
+    expected += ref.count(probe[i]);
+  }
+  EXPECT_EQ(expected, hits);
+  std::vector<uint32_t> all;
+  set.call_each([&all](uint32_t v) { all.push_back(v); });
+  EXPECT_TRUE(std::equal(all.begin(), all.end(), ref.begin(), ref.end()));
+  // erasing most of the bitmap chunk turns it back into an array
+  for (uint32_t i = 0; i < 19000; i++) {
+    EXPECT_EQ(1u, set.erase((1u << 20) + i * 3));
+  }
+  EXPECT_EQ(0u, set.erase(1u << 20));
+  EXPECT_EQ(4000u, set.size());
+  EXPECT_EQ(1u, set.count((1u << 20) + 19999 * 3));
+  EXPECT_LT(set.memory_usage(), 4000u * sizeof(uint64_t));
+}
+
+TEST(IntSetTest, unite_and_intersect) {
+  tscontainer::tsintset<uint64_t> a;
+  tscontainer::tsintset<uint64_t> b;
+  for (uint64_t i = 0; i < 10000; i++) {
+    a.insert(i * 2);
+    b.insert(i * 3);
+    b.insert((uint64_t(1) << 40) + i);
+  }
+  tscontainer::tsintset<uint64_t> u;
+  u.unite(a);
+  u.unite(b);
+  // multiples of 2 or 3 below 20000, plus the high range
+  EXPECT_EQ(10000u + 10000u - 3334u + 10000u, u.size());
+  a.intersect(b);
+  EXPECT_EQ(3334u, a.size());
+  EXPECT_EQ(1u, a.count(6));
+  EXPECT_EQ(0u, a.count(4));
+  u.intersect(a);
+  EXPECT_EQ(3334u, u.size());
+}
+
+TEST(IntSetTest, array_kernels) {
+  // array chunks of assorted sizes against std::set
+  uint64_t x = 88172645463325252ull;
+  for (int round = 0; round < 20; round++) {
+    tscontainer::tsintset<uint32_t> a;
+    tscontainer::tsintset<uint32_t> b;
+    std::set<uint32_t> ra;
+    std::set<uint32_t> rb;
+    std::vector<uint32_t> batch;
+    for (int i = 0; i < 50 * round + 3; i++) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      uint32_t v = static_cast<uint32_t>(x % 3000);
+      batch.push_back(v);
+      ra.insert(v);
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      b.insert(static_cast<uint32_t>(x % 3000));
+      rb.insert(static_cast<uint32_t>(x % 3000));
+    }
+    EXPECT_EQ(ra.size(), a.insert_many(batch.begin(), batch.end()));
+    std::vector<uint32_t> expected;
+    std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                          std::back_inserter(expected));
+    tscontainer::tsintset<uint32_t> u;
+    u.unite(a);
+    u.unite(b);
+    EXPECT_EQ(ra.size() + rb.size() - expected.size(), u.size());
+    a.intersect(b);
+    std::vector<uint32_t> got;
+    a.call_each([&got](uint32_t v) { got.push_back(v); });
+    EXPECT_EQ(expected, got);
+  }
+  // two arrays over ARRAY_MAX together whose union fits stay an array
+  tscontainer::tsintset<uint32_t> a;
+  tscontainer::tsintset<uint32_t> b;
+  for (uint32_t i = 0; i < 3000; i++) {
+    a.insert(i);
+    b.insert(i + 1000);
+  }
+  a.unite(b);
+  EXPECT_EQ(4000u, a.size());
+  EXPECT_LT(a.memory_usage(), 4000u * sizeof(uint64_t));
+}
+
+TEST(CowMapTest, snapshot_isolation) {
+  tscontainer::tscowmap<int, int> map{{1, 1}, {2, 2}};
+  auto snap = map.snapshot();
+  EXPECT_TRUE(map.insert(std::make_pair(3, 3)));
+  EXPECT_FALSE(map.insert(std::make_pair(3, 4)));
+  EXPECT_EQ(1u, map.erase(1));
+  EXPECT_EQ(0u, map.erase(1));
+  // The old snapshot is untouched by later writes.
+  EXPECT_EQ(2u, snap->size());
+  EXPECT_EQ(1u, snap->count(1));
+  EXPECT_EQ(2u, map.size());
+  int value = 0;
+  EXPECT_TRUE(map.read_copy(3, value));
+  EXPECT_EQ(3, value);
+  map.insert_or_assign(3, 30);
+  EXPECT_TRUE(map.read_copy(3, value));
+  EXPECT_EQ(30, value);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(CowMapTest, batched_update) {
+  tscontainer::tscowmap<int, int> map;
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; t++) {
+    readers.emplace_back([&map, &stop]() {
+      while (!stop.load()) {
+        // Every version holds a full batch: key i maps to -i.
+        int sum = 0;
+        size_t count = 0;
+        map.call_each([&](const std::pair<const int, int>& p) {
+          sum += p.first + p.second;
+          count++;
+        });
+        EXPECT_EQ(0, sum);
+        EXPECT_EQ(0u, count % 10);
+      }
+    });
+  }
+  for (int batch = 0; batch < 100; batch++) {
+    map.update([batch](std::map<int, int>& m) {
+      for (int i = 0; i < 10; i++) m.emplace(batch * 10 + i, -(batch * 10 + i));
+    });
+  }
+  stop = true;
+  for (auto& th : readers) th.join();
+  EXPECT_EQ(1000u, map.size());
+}
+
+TEST(PoolAllocatorTest, cross_thread_churn) {
+  using alloc = tscontainer::pool_allocator<std::pair<const int, int>>;
+  tscontainer::tsmap<int, int, std::less<int>, alloc> map;
+  tscontainer::tsset<int, std::less<int>, tscontainer::pool_allocator<int>>
+      set;
+  auto fill = [&](int t) {
+    for (int i = t * 1000; i < (t + 1) * 1000; i++) {
+      map.insert(std::make_pair(i, i));
+      set.insert(i);
+    }
+  };
+  // every thread frees the nodes another thread allocated, then exits and
+  // hands its free list back
+  for (int round = 0; round < 3; round++) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back(fill, t);
+    }
+    for (auto& th : threads) th.join();
+    EXPECT_EQ(4000u, map.size());
+    threads.clear();
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&, t]() {
+        int other = (t + 1) % 4;
+        for (int i = other * 1000; i < (other + 1) * 1000; i += 2) {
+          EXPECT_EQ(1u, map.erase(i));
+          EXPECT_EQ(1u, set.erase(i));
+        }
+      });
+    }
+    for (auto& th : threads) th.join();
+    EXPECT_EQ(2000u, map.size());
+    EXPECT_EQ(2000u, set.size());
+  }
+  map.call_each([](const std::pair<const int, int>& p) {
+    EXPECT_EQ(1, p.first % 2);
+    EXPECT_EQ(p.first, p.second);
+  });
+}
+
+TEST(ParallelTest, call_each_and_reduce) {
+  tscontainer::tsmap<int, long> map;
+  tscontainer::tsset<int> set;
+  for (int i = 0; i < 100000; i++) {
+    map.insert(std::make_pair(i, 0));
+    set.insert(i);
+  }
+  std::atomic<long> visited{0};
+  map.parallel_call_each([&visited](std::pair<const int, long>& p) {
+    p.second = p.first * 2L;
+    visited++;
+  }, 4);
+  EXPECT_EQ(100000, visited.load());
+  auto add = [](long a, long b) { return a + b; };
+  long sum = map.parallel_reduce(
+      0L, [](long acc, const std::pair<const int, long>& p) {
+        return acc + p.second;
+      }, add, 4);
+  EXPECT_EQ(99999L * 100000L, sum);
+
+  // a user-provided executor, here counting the tasks it was given
+  int tasks = 0;
+  tscontainer::thread_executor threads;
+  auto exec = [&tasks, &threads](std::function<void()> task) {
+    tasks++;
+    threads(std::move(task));
+  };
+  long set_sum = set.parallel_reduce(
+      0L, [](long acc, int k) { return acc + k; }, add, exec, 3);
+  EXPECT_EQ(99999L * 100000L / 2, set_sum);
+  EXPECT_EQ(2, tasks);
+  visited = 0;
+  set.parallel_call_each([&visited](int) { visited++; }, exec, 3);
+  EXPECT_EQ(100000, visited.load());
+
+  tscontainer::tsset<int> small;
+  for (int i = 1; i <= 3; i++) small.insert(i);
+  EXPECT_EQ(6L, small.parallel_reduce(
+                    0L, [](long acc, int k) { return acc + k; }, add));
+}
+
+TEST(CursorTest, chunked_scan) {
+  tscontainer::tsmap<int, int> map;
+  tscontainer::tsset<int> set;
+  for (int i = 0; i < 1000; i++) {
+    map.insert(std::make_pair(i, -i));
+    set.insert(i);
+  }
+  auto cur = map.scan();
+  std::vector<std::pair<int, int>> chunk;
+  std::vector<std::pair<int, int>> all;
+  while (cur.next(64, std::back_inserter(chunk)) > 0) {
+    EXPECT_LE(chunk.size(), 64u);
+    all.insert(all.end(), chunk.begin(), chunk.end());
+    chunk.clear();
+  }
+  EXPECT_TRUE(cur.done());
+  ASSERT_EQ(1000u, all.size());
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(i, all[i].first);
+    EXPECT_EQ(-i, all[i].second);
+  }
+
+  // bounded, with a writer erasing and inserting between chunks
+  std::atomic<bool> stop{false};
+  std::thread writer([&]() {
+    for (int i = 0; !stop; i = (i + 1) % 1000) {
+      set.erase(i);
+      set.insert(i);
+    }
+  });
+  auto set_cur = set.scan(100, 900);
+  std::vector<int> keys;
+  int buf[50];
+  for (size_t n; (n = set_cur.next(50, buf)) > 0;) {
+    keys.insert(keys.end(), buf, buf + n);
+  }
+  stop = true;
+  writer.join();
+  ASSERT_FALSE(keys.empty());
+  EXPECT_LE(100, keys.front());
+  EXPECT_GT(900, keys.back());
+  for (size_t i = 1; i < keys.size(); i++) {
+    EXPECT_LT(keys[i - 1], keys[i]);
+  }
+  EXPECT_EQ(0u, set.scan(5, 5).next(10, buf));
+  EXPECT_EQ(0u, set.scan(9, 3).next(10, buf));
+}
+
+#if defined(TSCONTAINER_LOCK_STATS)
+TEST(StatsTest, map_operations) {
+  tscontainer::tsmap<int, int> map;
+  map.insert(std::make_pair(1, 1));
+  map.count(1);
+  map.find_or_emplace(2, 2);
+  map.call_each([](std::pair<const int, int>&) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  });
+  base::LockStatsSnapshot s = map.stats();
+  EXPECT_EQ(2u, s.read_acquires);
+  EXPECT_EQ(1u, s.write_acquires);
+  EXPECT_EQ(1u, s.upgrade_acquires);
+  EXPECT_EQ(1u, s.upgrades);
+  EXPECT_GE(s.max_read_hold_ns, 10000000u);
+  tscontainer::tsset<int, std::less<int>, std::allocator<int>,
+                     base::MutexRWLock<>> unrecorded;
+  unrecorded.insert(1);
+  EXPECT_EQ(0u, unrecorded.stats().write_acquires);
+}
+#endif
+
+TEST(SnapshotTest, save_and_load) {
+  std::string map_path = ::testing::TempDir() + "tscontainer_map.snap";
+  std::string set_path = ::testing::TempDir() + "tscontainer_set.snap";
+  tscontainer::tsmap<int, double> map;
+  tscontainer::tsset<uint64_t> set;
+  for (int i = 0; i < 100000; i++) {
+    map.insert(std::make_pair(i * 3, i * 0.5));
+    set.insert(static_cast<uint64_t>(i) << 20);
+  }
+  ASSERT_TRUE(map.save_snapshot(map_path));
+  ASSERT_TRUE(set.save_snapshot(set_path));
+
+  tscontainer::tsmap<int, double> map2;
+  map2.insert(std::make_pair(-1, -1.0));
+  ASSERT_TRUE(map2.load_snapshot(map_path));
+  EXPECT_EQ(100000u, map2.size());
+  EXPECT_EQ(0u, map2.count(-1));
+  EXPECT_EQ(2.5, map2.get_or(15, 0));
+  tscontainer::tsset<uint64_t> set2;
+  ASSERT_TRUE(set2.load_snapshot(set_path));
+  EXPECT_EQ(100000u, set2.size());
+  EXPECT_EQ(1u, set2.count(uint64_t(99999) << 20));
+
+  // wrong types, wrong container, missing file: nothing changes
+  tscontainer::tsmap<int, float> other;
+  other.insert(std::make_pair(1, 1.0f));
+  EXPECT_FALSE(other.load_snapshot(map_path));
+  EXPECT_FALSE(other.load_snapshot(set_path));
+  EXPECT_FALSE(other.load_snapshot(map_path + ".missing"));
+  EXPECT_EQ(1u, other.size());
+  // truncated
+  ASSERT_EQ(0, truncate(map_path.c_str(), 100));
+  EXPECT_FALSE(map2.load_snapshot(map_path));
+  EXPECT_EQ(100000u, map2.size());
+  std::remove(map_path.c_str());
+  std::remove(set_path.c_str());
+}
+
+TEST(SnapshotTest, concurrent_saves) {
+  std::string path = ::testing::TempDir() + "tscontainer_concurrent.snap";
+  tscontainer::tsmap<int, int> a;
+  tscontainer::tsmap<int, int> b;
+  for (int i = 0; i < 20000; i++) {
+    a.insert(std::make_pair(i, 1));
+    b.insert(std::make_pair(i * 2, 2));
+  }
+  // Each save has its own temporary file, so path always ends up as one
+  // complete snapshot of either map.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE((t % 2 == 0 ? a : b).save_snapshot(path));
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  tscontainer::tsmap<int, int> loaded;
+  ASSERT_TRUE(loaded.load_snapshot(path));
+  EXPECT_EQ(20000u, loaded.size());
+  int value = loaded.get_or(2, 0);
+  EXPECT_TRUE(value == 1 || value == 2);
+  EXPECT_EQ(value == 1 ? 1u : 0u, loaded.count(1));
+  std::remove(path.c_str());
+}
+
+TEST(FeedTest, map_events) {
+  using map_type = tscontainer::tsmap<int, int>;
+  map_type map;
+  map.insert(std::make_pair(0, 0));
+  map_type::subscription sub = map.subscribe(8);
+  map.insert(std::make_pair(1, 10));
+  map.insert(std::make_pair(1, 11));  // no change, no event
+  map.upsert(1, 12);
+  map.compute(2, [](int& v) { v = 20; });
+  map.erase(0);
+  map.erase(0);
+  map.clear();
+  std::vector<map_type::change> events;
+  EXPECT_EQ(5u, sub.pending());
+  EXPECT_EQ(5u, sub.poll(100, std::back_inserter(events)));
+  ASSERT_EQ(5u, events.size());
+  EXPECT_EQ(tscontainer::change_op::insert, events[0].op);
+  EXPECT_EQ(1, events[0].key);
+  EXPECT_EQ(10, events[0].value);
+  EXPECT_EQ(tscontainer::change_op::assign, events[1].op);
+  EXPECT_EQ(12, events[1].value);
+  EXPECT_EQ(tscontainer::change_op::insert, events[2].op);
+  EXPECT_EQ(20, events[2].value);
+  EXPECT_EQ(tscontainer::change_op::erase, events[3].op);
+  EXPECT_EQ(0, events[3].key);
+  EXPECT_EQ(tscontainer::change_op::clear, events[4].op);
+  EXPECT_EQ(0u, sub.poll(100, std::back_inserter(events)));
+  EXPECT_FALSE(sub.overrun());
+
+  // more than the capacity behind
+  for (int i = 0; i < 20; i++) {
+    map.insert(std::make_pair(i, i));
+  }
+  EXPECT_EQ(0u, sub.poll(100, std::back_inserter(events)));
+  EXPECT_TRUE(sub.overrun());
+  sub.restart();
+  EXPECT_FALSE(sub.overrun());
+  map.combined_erase(3);
+  events.clear();
+  EXPECT_EQ(1u, sub.poll(100, std::back_inserter(events)));
+  EXPECT_EQ(tscontainer::change_op::erase, events[0].op);
+  EXPECT_EQ(3, events[0].key);
+
+  // wholesale replacement overruns
+  map = map_type();
+  EXPECT_EQ(0u, sub.poll(100, std::back_inserter(events)));
+  EXPECT_TRUE(sub.overrun());
+}
+
+TEST(FeedTest, set_mirror) {
+  tscontainer::tsset<std::string> set;
+  set.insert("a");
+  auto sub = set.subscribe(1024);
+  std::set<std::string> mirror;
+  set.call_each([&mirror](const std::string& k) { mirror.insert(k); });
+  std::atomic<bool> done{false};
+  std::thread writer([&set, &done]() {
+    for (int i = 0; i < 20000; i++) {
+      std::string k = std::to_string(i % 500);
+      if (i % 3 == 2) {
+        set.erase(k);
+      } else {
+        set.insert(k);
+      }
+    }
+    done = true;
+  });
+  std::vector<tscontainer::tsset<std::string>::change> events;
+  auto apply = [&]() {
+    events.clear();
+    sub.poll(256, std::back_inserter(events));
+    if (sub.overrun()) {
+      sub.restart();
+      mirror.clear();
+      set.call_each([&mirror](const std::string& k) { mirror.insert(k); });
+      return;
+    }
+    for (const auto& e : events) {
+      if (e.op == tscontainer::change_op::erase) {
+        mirror.erase(e.key);
+      } else if (e.op == tscontainer::change_op::clear) {
+        mirror.clear();
+      } else {
+        mirror.insert(e.key);
+      }
+    }
+  };
+  while (!done) {
+    apply();
+  }
+  writer.join();
+  while (sub.pending() > 0) {
+    apply();
+  }
+  std::set<std::string> expected;
+  set.call_each([&expected](const std::string& k) { expected.insert(k); });
+  EXPECT_EQ(expected, mirror);
+}
+
+TEST(NullRWLockTest, single_thread) {
+  IntMap<base::NullRWLock> map;
+  map.insert(std::make_pair(1, 1));
+  map.emplace(2, 2);
+  EXPECT_EQ(2u, map.size());
+  EXPECT_EQ(2, map.at(2));
+  map.clear();
+  EXPECT_TRUE(map.empty());
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,248 @@
+#ifndef __TSCOWMAP_H__
+#define __TSCOWMAP_H__
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "tsepoch.hpp"
+namespace tscontainer {
+/**
+ * @brief tscowmap, copy-on-write map for rarely written, heavily read data
+ *
+ * Readers pin an epoch_domain in their own slot and load the published
+ * pointer, so a read never writes a cache line shared with other readers
+ * and never waits for writers. Writers serialize on a mutex, copy the
+ * current map, apply their change and publish the copy atomically, so every
+ * write costs O(size()); use update() to coalesce several changes into one
+ * publication. A replaced version is retired and freed by a later write
+ * once no snapshot can still see it; holding a snapshot for long delays
+ * that.
+ *
+ * @tparam Key key
+ * @tparam T t
+ * @tparam Compare compare
+ * @tparam std::allocator<std::pair<const Key, T>> alloc
+ */
+template <class Key, class T, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, T>>>
+class tscowmap {
+ public:
+  // map
+  using map = typename std::map<Key, T, Compare, Alloc>;
+  // key_type
+  using key_type = typename map::key_type;
+  // value_type
+  using value_type = typename map::value_type;
+  // mapped_type
+  using mapped_type = typename map::mapped_type;
+  // size_type
+  using size_type = typename map::size_type;
+
+ private:
+  // current_, the published version
+  std::atomic<const map*> current_;
+  mutable epoch_domain domain_;
+  // writer_mtx, serializes copy-modify-publish and guards retired_
+  std::mutex writer_mtx;
+  // replaced versions and the epoch they were replaced in, oldest first
+  std::vector<std::pair<const map*, uint64_t>> retired_;
+
+  // Called under writer_mtx.
+  void publish(const map* next) noexcept {
+    const map* old = current_.exchange(next);
+    retired_.emplace_back(old, domain_.current());
+    domain_.try_advance();
+    uint64_t epoch = domain_.try_advance();
+    auto it = retired_.begin();
+    for (; it != retired_.end() && epoch_domain::safe(it->second, epoch);
+         ++it) {
+      delete it->first;
+    }
+    retired_.erase(retired_.begin(), it);
+  }
+
+ public:
+  /**
+   * @brief snapshot_type, pins one immutable published version for its
+   * lifetime
+   *
+   */
+  class snapshot_type {
+   public:
+    snapshot_type(const snapshot_type&) = delete;
+    snapshot_type& operator=(const snapshot_type&) = delete;
+
+    const map& operator*() const noexcept { return *map_; }
+    const map* operator->() const noexcept { return map_; }
+
+   private:
+    friend class tscowmap;
+    explicit snapshot_type(const tscowmap& owner) noexcept
+        : guard_(owner.domain_), map_(owner.current_.load()) {}
+
+    epoch_guard guard_;
+    const map* map_;
+  };
+
+  /**
+   * @brief Construct a new tscowmap object
+   *
+   */
+  tscowmap() : current_(new map()) {}
+  /**
+   * @brief Construct a new tscowmap object
+   *
+   * @param x x
+   */
+  explicit tscowmap(const map& x) : current_(new map(x)) {}
+  /**
+   * @brief Construct a new tscowmap object
+   *
+   * @param il il
+   */
+  tscowmap(std::initializer_list<value_type> il) : current_(new map(il)) {}
+
+  tscowmap(const tscowmap&) = delete;
+  tscowmap& operator=(const tscowmap&) = delete;
+  /**
+   * @brief Destroy the tscowmap object, no snapshot may be left
+   *
+   */
+  ~tscowmap() {
+    delete current_.load();
+    for (auto& r : retired_) {
+      delete r.first;
+    }
+  }
+
+  /**
+   * @brief snapshot, the current version; it never changes, and stays valid
+   * while the returned snapshot_type is alive
+   *
+   * @return snapshot_type snapshot
+   */
+  snapshot_type snapshot() const noexcept { return snapshot_type(*this); }
+  /**
+   * @brief empty
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return snapshot()->empty(); }
+  /**
+   * @brief size
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept { return snapshot()->size(); }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    return snapshot()->count(k);
+  }
+  /**
+   * @brief read_copy, copy the value of k out of the current snapshot
+   *
+   * @param k k
+   * @param value receives the value of k if found
+   * @return true k found
+   * @return false k not found, value untouched
+   */
+  bool read_copy(const key_type& k, mapped_type& value) const noexcept {
+    snapshot_type snap = snapshot();
+    auto it = snap->find(k);
+    if (it == snap->end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return true inserted
+   * @return false key already present, nothing published
+   */
+  bool insert(const value_type& val) noexcept {
+    std::lock_guard<std::mutex> lg{writer_mtx};
+    const map* current = current_.load();
+    if (current->count(val.first) != 0) {
+      return false;
+    }
+    map* next = new map(*current);
+    next->insert(val);
+    publish(next);
+    return true;
+  }
+  /**
+   * @brief insert_or_assign
+   *
+   * @param k k
+   * @param obj obj
+   */
+  template <class M>
+  void insert_or_assign(const key_type& k, M&& obj) noexcept {
+    update([&](map& m) { m.insert_or_assign(k, std::forward<M>(obj)); });
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type, nothing is published if k is missing
+   */
+  size_type erase(const key_type& k) noexcept {
+    std::lock_guard<std::mutex> lg{writer_mtx};
+    const map* current = current_.load();
+    if (current->count(k) == 0) {
+      return 0;
+    }
+    map* next = new map(*current);
+    size_type erased = next->erase(k);
+    publish(next);
+    return erased;
+  }
+  /**
+   * @brief clear
+   *
+   */
+  void clear() noexcept {
+    std::lock_guard<std::mutex> lg{writer_mtx};
+    publish(new map());
+  }
+  /**
+   * @brief update, apply a batch of changes to a private copy and publish it
+   * as one new version; readers see all of them or none
+   *
+   * @tparam F void(map&)
+   * @param f f
+   */
+  template <typename F>
+  void update(F f) noexcept {
+    std::lock_guard<std::mutex> lg{writer_mtx};
+    map* next = new map(*current_.load());
+    f(*next);
+    publish(next);
+  }
+  /**
+   * @brief call_each, iterate the current snapshot; writers are not blocked
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) const noexcept {
+    snapshot_type snap = snapshot();
+    std::for_each(snap->begin(), snap->end(), pred);
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSCOWMAP_H__
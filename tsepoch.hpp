@@ -0,0 +1,106 @@
+#ifndef __TSEPOCH_H__
+#define __TSEPOCH_H__
+#include <atomic>
+#include <cstdint>
+#include "lock_wait.h"
+namespace tscontainer {
+/**
+ * @brief epoch_domain, epoch-based reclamation for lock-free containers
+ *
+ * Readers and writers pin the domain with an epoch_guard while they touch
+ * shared nodes. A node unlinked and retired in epoch e may be freed once
+ * the global epoch reached e + 2: the epoch only advances from e + 1 to
+ * e + 2 when no guard entered in epoch e is left. Guards register in
+ * per-thread, cache-line-padded slots (one counter per epoch parity), so
+ * pinning never writes a cache line shared with other cores.
+ *
+ */
+class epoch_domain {
+ public:
+  // number of reader slots
+  static const uint32_t SLOT_NUM = 64;
+
+  epoch_domain() = default;
+  epoch_domain(const epoch_domain&) = delete;
+  epoch_domain& operator=(const epoch_domain&) = delete;
+
+  /**
+   * @brief current epoch
+   *
+   * @return uint64_t epoch
+   */
+  uint64_t current() const noexcept { return epoch_.load(); }
+  /**
+   * @brief try_advance, moves to the next epoch unless a guard of the
+   * previous epoch is still pinned
+   *
+   * @return uint64_t the epoch afterwards
+   */
+  uint64_t try_advance() noexcept {
+    uint64_t epoch = epoch_.load();
+    // guards of epoch - 1 share the parity of epoch + 1
+    for (const slot& s : slots_) {
+      if (s.active[(epoch + 1) & 1].load() != 0) {
+        return epoch;
+      }
+    }
+    epoch_.compare_exchange_strong(epoch, epoch + 1);
+    return epoch_.load();
+  }
+  /**
+   * @brief safe, whether a node retired in retire_epoch can be freed
+   *
+   * @param retire_epoch epoch read after the node was unlinked
+   * @param epoch current epoch
+   * @return true no guard can still reach the node
+   */
+  static bool safe(uint64_t retire_epoch, uint64_t epoch) noexcept {
+    return retire_epoch + 2 <= epoch;
+  }
+
+ private:
+  friend class epoch_guard;
+
+  struct alignas(base::CACHE_LINE_SIZE) slot {
+    std::atomic<int32_t> active[2] = {{0}, {0}};
+  };
+
+  slot slots_[SLOT_NUM];
+  alignas(base::CACHE_LINE_SIZE) std::atomic<uint64_t> epoch_ = {2};
+
+  slot& this_thread_slot() noexcept {
+    static std::atomic<uint32_t> thread_num = {0};
+    static thread_local uint32_t index = thread_num.fetch_add(1) % SLOT_NUM;
+    return slots_[index];
+  }
+};
+
+/**
+ * @brief epoch_guard, pins an epoch_domain for its lifetime; guards nest
+ *
+ */
+class epoch_guard {
+ public:
+  explicit epoch_guard(epoch_domain& domain) noexcept {
+    epoch_domain::slot& s = domain.this_thread_slot();
+    while (true) {
+      uint64_t epoch = domain.epoch_.load();
+      active_ = &s.active[epoch & 1];
+      active_->fetch_add(1);
+      // re-check, so the advance that might free what we read next sees us
+      if (domain.epoch_.load() == epoch) {
+        break;
+      }
+      active_->fetch_sub(1);
+    }
+  }
+  ~epoch_guard() { active_->fetch_sub(1); }
+
+  epoch_guard(const epoch_guard&) = delete;
+  epoch_guard& operator=(const epoch_guard&) = delete;
+
+ private:
+  std::atomic<int32_t>* active_;
+};
+}  // namespace tscontainer
+#endif  // __TSEPOCH_H__
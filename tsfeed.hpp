@@ -0,0 +1,303 @@
+#ifndef __TSFEED_H__
+#define __TSFEED_H__
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include "tsepoch.hpp"
+namespace tscontainer {
+/**
+ * @brief change_op, kind of a change_event
+ *
+ */
+enum class change_op {
+  // key inserted with value
+  insert,
+  // value of an existing key overwritten
+  assign,
+  // key erased
+  erase,
+  // all elements erased
+  clear
+};
+/**
+ * @brief change_event, one change of a container with a change feed
+ *
+ * @tparam Key Key
+ * @tparam T mapped type, void for sets
+ */
+template <class Key, class T>
+struct change_event {
+  change_op op;
+  // value-initialized for clear
+  Key key;
+  // value-initialized for erase and clear
+  T value;
+};
+template <class Key>
+struct change_event<Key, void> {
+  change_op op;
+  // value-initialized for clear
+  Key key;
+};
+
+namespace detail {
+template <class Key, class T>
+struct change_value {
+  static void set(change_event<Key, T>& e, const T* value) noexcept {
+    e.value = value != nullptr ? *value : T();
+  }
+};
+template <class Key>
+struct change_value<Key, void> {
+  static void set(change_event<Key, void>&, const void*) noexcept {}
+};
+
+/**
+ * @brief change_ring, bounded ring of the last capacity changes of one
+ * container
+ *
+ * There is one producer at a time: the container publishes while it holds
+ * its write lock. Each slot points to an immutable node holding one event
+ * and its sequence number; publishing fills a recycled node and swaps it
+ * into the slot, so the producer never waits for consumers. Consumers read
+ * under an epoch_guard and never write shared state; a node pushed out of
+ * its slot is retired and reused only once no consumer can still be
+ * reading it. All nodes are allocated up front, capacity plus three retire
+ * batches, so publishing never allocates; when the spare nodes run out the
+ * producer waits for the epoch to move past the oldest retired ones. A
+ * consumer that finds a newer sequence number in the slot it wants has been
+ * overrun.
+ *
+ * @tparam Key Key
+ * @tparam T mapped type, void for sets
+ */
+template <class Key, class T>
+class change_ring {
+ public:
+  using event = change_event<Key, T>;
+
+  // capacity is rounded up to a power of two
+  explicit change_ring(std::size_t capacity) noexcept {
+    capacity_ = 2;
+    while (capacity_ < capacity) {
+      capacity_ *= 2;
+    }
+    slots_.reset(new std::atomic<node*>[capacity_]);
+    for (std::size_t i = 0; i < capacity_; i++) {
+      slots_[i].store(nullptr, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < capacity_ + RETIRE_BATCH * 3; i++) {
+      node* n = new node;
+      n->retire_next = free_;
+      free_ = n;
+    }
+  }
+  ~change_ring() {
+    for (std::size_t i = 0; i < capacity_; i++) {
+      delete slots_[i].load(std::memory_order_relaxed);
+    }
+    free_chain(retired_head_);
+    free_chain(free_);
+  }
+  change_ring(const change_ring&) = delete;
+  change_ring& operator=(const change_ring&) = delete;
+
+  std::size_t capacity() const noexcept { return capacity_; }
+  // sequence number of the next event
+  uint64_t head() const noexcept {
+    return head_.load(std::memory_order_acquire);
+  }
+
+  // Appends one event; key and value may be nullptr, see change_event.
+  void publish(change_op op, const Key* key, const T* value) noexcept {
+    node* n = take();
+    n->reset = false;
+    n->e.op = op;
+    n->e.key = key != nullptr ? *key : Key();
+    change_value<Key, T>::set(n->e, value);
+    push(n);
+  }
+  // Appends a marker that overruns every consumer reaching it, for changes
+  // that cannot be described event by event.
+  void reset() noexcept {
+    node* n = take();
+    n->reset = true;
+    push(n);
+  }
+
+  /**
+   * @brief read, copies the events from sequence number next on to out
+   *
+   * @param next next event to read, advanced past the copied events
+   * @param n at most n events
+   * @param out output iterator accepting event
+   * @param lost set if an event the consumer has not read yet was
+   * overwritten or a reset was reached
+   * @return std::size_t number of events copied
+   */
+  template <class OutputIt>
+  std::size_t read(uint64_t& next, std::size_t n, OutputIt out,
+                   bool& lost) noexcept {
+    epoch_guard guard(domain_);
+    uint64_t head = this->head();
+    if (head - next > capacity_) {
+      lost = true;
+      return 0;
+    }
+    std::size_t copied = 0;
+    for (; copied < n && next != head; copied++, next++) {
+      const node* p =
+          slots_[next & (capacity_ - 1)].load(std::memory_order_acquire);
+      if (p->seq != next || p->reset) {
+        lost = true;
+        break;
+      }
+      *out++ = p->e;
+    }
+    return copied;
+  }
+
+ private:
+  // spare nodes beyond the slots: three batches of RETIRE_BATCH
+  static const uint32_t RETIRE_BATCH = 64;
+
+  struct node {
+    uint64_t seq = 0;
+    bool reset = false;
+    event e = event();
+    node* retire_next = nullptr;
+    uint64_t retire_epoch = 0;
+  };
+
+  std::unique_ptr<std::atomic<node*>[]> slots_;
+  std::size_t capacity_;
+  alignas(base::CACHE_LINE_SIZE) std::atomic<uint64_t> head_ = {0};
+  epoch_domain domain_;
+  // producer only: retired nodes, oldest first, and nodes ready for reuse
+  node* retired_head_ = nullptr;
+  node* retired_tail_ = nullptr;
+  node* free_ = nullptr;
+
+  node* take() noexcept {
+    // the pool exceeds the slots, so with no free node some are retired;
+    // only a consumer still pinning an old epoch makes this wait
+    base::SpinBackoff backoff;
+    while (free_ == nullptr) {
+      domain_.try_advance();
+      uint64_t epoch = domain_.try_advance();
+      // retired in epoch order, so the safe ones are a prefix
+      while (retired_head_ != nullptr &&
+             epoch_domain::safe(retired_head_->retire_epoch, epoch)) {
+        node* n = retired_head_;
+        retired_head_ = n->retire_next;
+        n->retire_next = free_;
+        free_ = n;
+      }
+      if (retired_head_ == nullptr) {
+        retired_tail_ = nullptr;
+      }
+      if (free_ == nullptr && !backoff.Spin()) {
+        std::this_thread::yield();
+      }
+    }
+    node* n = free_;
+    free_ = n->retire_next;
+    n->retire_next = nullptr;
+    return n;
+  }
+  void push(node* n) noexcept {
+    uint64_t seq = head_.load(std::memory_order_relaxed);
+    n->seq = seq;
+    node* old = slots_[seq & (capacity_ - 1)].exchange(
+        n, std::memory_order_acq_rel);
+    head_.store(seq + 1, std::memory_order_release);
+    if (old != nullptr) {
+      old->retire_epoch = domain_.current();
+      if (retired_tail_ != nullptr) {
+        retired_tail_->retire_next = old;
+      } else {
+        retired_head_ = old;
+      }
+      retired_tail_ = old;
+    }
+  }
+  static void free_chain(node* n) noexcept {
+    while (n != nullptr) {
+      node* next = n->retire_next;
+      delete n;
+      n = next;
+    }
+  }
+};
+}  // namespace detail
+
+/**
+ * @brief change_subscription, one consumer of a container's change feed
+ *
+ * Starts at the newest change and reads forward from its own position;
+ * consumers never slow down the container or each other. A consumer that
+ * falls more than the feed capacity behind, or reaches a change that
+ * replaced the content wholesale (swap, assignment, load_snapshot), is
+ * overrun: it has to call restart() and resynchronize from a full scan.
+ *
+ * @tparam Key Key
+ * @tparam T mapped type, void for sets
+ */
+template <class Key, class T>
+class change_subscription {
+ public:
+  using event = change_event<Key, T>;
+
+  explicit change_subscription(
+      std::shared_ptr<detail::change_ring<Key, T>> ring) noexcept
+      : ring_(std::move(ring)), next_(ring_->head()) {}
+
+  /**
+   * @brief poll, copy up to n pending changes in order to out
+   *
+   * @tparam OutputIt output iterator accepting event; it must not call
+   * into the container, whose writers may wait for the poll to finish
+   * @param n n
+   * @param out out
+   * @return std::size_t number of changes copied, 0 if none is pending or
+   * the subscription is overrun
+   */
+  template <class OutputIt>
+  std::size_t poll(std::size_t n, OutputIt out) noexcept {
+    if (overrun_) {
+      return 0;
+    }
+    return ring_->read(next_, n, out, overrun_);
+  }
+  /**
+   * @brief overrun, whether changes were lost; poll() returns nothing more
+   * until restart()
+   *
+   */
+  bool overrun() const noexcept { return overrun_; }
+  /**
+   * @brief restart, skip to the newest change and clear overrun()
+   *
+   * Call it before the full resync: changes made during the scan are then
+   * polled afterwards, and applying them once more is harmless.
+   */
+  void restart() noexcept {
+    next_ = ring_->head();
+    overrun_ = false;
+  }
+  /**
+   * @brief pending, number of changes not polled yet, including lost ones
+   *
+   */
+  uint64_t pending() const noexcept { return ring_->head() - next_; }
+
+ private:
+  std::shared_ptr<detail::change_ring<Key, T>> ring_;
+  uint64_t next_;
+  bool overrun_ = false;
+};
+}  // namespace tscontainer
+#endif  // __TSFEED_H__
@@ -0,0 +1,352 @@
+#ifndef __TSFLATMAP_H__
+#define __TSFLATMAP_H__
+#include <algorithm>
+#include <functional>
+#include <memory>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "atomic_rw_lock.h"
+#include "rw_lock_guard.h"
+namespace tscontainer {
+/**
+ * @brief tsflatmap, map kept as one sorted std::vector, for mostly static,
+ * scan-heavy data
+ *
+ * Elements are contiguous, so scans run at memory bandwidth and there is no
+ * per-element node overhead; lookups are binary searches. Inserting or
+ * erasing a single element moves the elements behind it, so build large
+ * tables with the range constructor or assign(), which sort once. The
+ * locking follows tsmap. Any insert may reallocate the vector, so no
+ * iterator or reference ever leaves the lock: look up with get or visit,
+ * scan with call_each or call_range.
+ *
+ * @tparam Key key
+ * @tparam T t
+ * @tparam Compare compare
+ * @tparam std::allocator<std::pair<Key, T>> alloc
+ * @tparam RWLock lock policy, see tsmap
+ */
+template <class Key, class T, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<Key, T>>,
+          class RWLock = base::AtomicRWLock>
+class tsflatmap {
+ public:
+  // key_type
+  using key_type = Key;
+  // mapped_type
+  using mapped_type = T;
+  // value_type
+  using value_type = std::pair<Key, T>;
+  // key_compare
+  using key_compare = Compare;
+  // vector
+  using vector = typename std::vector<value_type, Alloc>;
+  // size_type
+  using size_type = typename vector::size_type;
+
+ private:
+  // iterators stay inside: the vector may reallocate once the lock is gone
+  using iterator = typename vector::iterator;
+  using const_iterator = typename vector::const_iterator;
+  // mtx
+  mutable RWLock mtx;
+  // vec, sorted by key, keys unique
+  vector vec;
+  // comp
+  key_compare comp;
+
+  struct value_less {
+    const key_compare& comp;
+    bool operator()(const value_type& a, const key_type& k) const {
+      return comp(a.first, k);
+    }
+    bool operator()(const key_type& k, const value_type& a) const {
+      return comp(k, a.first);
+    }
+    bool operator()(const value_type& a, const value_type& b) const {
+      return comp(a.first, b.first);
+    }
+  };
+  iterator vec_lower_bound(const key_type& k) noexcept {
+    return std::lower_bound(vec.begin(), vec.end(), k, value_less{comp});
+  }
+  const_iterator vec_lower_bound(const key_type& k) const noexcept {
+    return std::lower_bound(vec.begin(), vec.end(), k, value_less{comp});
+  }
+  bool hit(const_iterator it, const key_type& k) const noexcept {
+    return it != vec.end() && !comp(k, it->first);
+  }
+  // Sorts v and drops later duplicates, keeping the first of each key.
+  void normalize(vector& v) const {
+    std::stable_sort(v.begin(), v.end(), value_less{comp});
+    v.erase(std::unique(v.begin(), v.end(),
+                        [this](const value_type& a, const value_type& b) {
+                          return !comp(a.first, b.first);
+                        }),
+            v.end());
+  }
+
+ public:
+  /**
+   * @brief Construct a new tsflatmap object
+   *
+   * @param comp compare
+   * @param alloc alloc
+   */
+  explicit tsflatmap(const key_compare& comp = key_compare(),
+                     const Alloc& alloc = Alloc()) noexcept
+      : vec(alloc), comp(comp) {}
+  /**
+   * @brief Construct a new tsflatmap object, sorting once
+   *
+   * @tparam InputIterator InputIterator
+   * @param first first
+   * @param last last
+   * @param comp comp
+   * @param alloc alloc
+   */
+  template <class InputIterator>
+  tsflatmap(InputIterator first, InputIterator last,
+            const key_compare& comp = key_compare(),
+            const Alloc& alloc = Alloc())
+      : vec(first, last, alloc), comp(comp) {
+    normalize(vec);
+  }
+  /**
+   * @brief Construct a new tsflatmap object
+   *
+   * @param il il
+   * @param comp comp
+   * @param alloc alloc
+   */
+  tsflatmap(std::initializer_list<value_type> il,
+            const key_compare& comp = key_compare(),
+            const Alloc& alloc = Alloc())
+      : tsflatmap(il.begin(), il.end(), comp, alloc) {}
+
+  tsflatmap(const tsflatmap&) = delete;
+  tsflatmap& operator=(const tsflatmap&) = delete;
+
+  /**
+   * @brief assign, replace the content, sorting once
+   *
+   * @tparam InputIterator InputIterator
+   * @param first first
+   * @param last last
+   */
+  template <class InputIterator>
+  void assign(InputIterator first, InputIterator last) noexcept {
+    vector next(first, last, vec.get_allocator());
+    normalize(next);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.swap(next);
+  }
+  /**
+   * @brief reserve
+   *
+   * @param n n
+   */
+  void reserve(size_type n) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.reserve(n);
+  }
+  /**
+   * @brief shrink_to_fit
+   *
+   */
+  void shrink_to_fit() noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.shrink_to_fit();
+  }
+  /**
+   * @brief empty
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return vec.empty();
+  }
+  /**
+   * @brief size
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return vec.size();
+  }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return true inserted
+   * @return false key already present, nothing changed
+   */
+  bool insert(const value_type& val) noexcept {
+    return find_or_emplace(val.first, val.second);
+  }
+  /**
+   * @brief find_or_emplace, see tsmap::find_or_emplace
+   *
+   * @tparam Args Args
+   * @param k k
+   * @param args arguments to construct the mapped value on a miss
+   * @return true inserted
+   * @return false k already present, nothing changed
+   */
+  template <class... Args>
+  bool find_or_emplace(const key_type& k, Args&&... args) noexcept {
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    iterator it = vec_lower_bound(k);
+    if (hit(it, k)) {
+      return false;
+    }
+    ulg.Upgrade();
+    vec.emplace(it, std::piecewise_construct, std::forward_as_tuple(k),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+    return true;
+  }
+  /**
+   * @brief upsert, insert k or overwrite its value
+   *
+   * @param k k
+   * @param value value
+   * @return true inserted
+   * @return false overwritten
+   */
+  bool upsert(const key_type& k, const mapped_type& value) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator it = vec_lower_bound(k);
+    if (hit(it, k)) {
+      it->second = value;
+      return false;
+    }
+    vec.emplace(it, k, value);
+    return true;
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator it = vec_lower_bound(k);
+    if (!hit(it, k)) {
+      return 0;
+    }
+    vec.erase(it);
+    return 1;
+  }
+  /**
+   * @brief clear
+   *
+   */
+  void clear() noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.clear();
+  }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return hit(vec_lower_bound(k), k) ? 1 : 0;
+  }
+#if __cplusplus >= 201703L
+  /**
+   * @brief get, copy the value of k out under the read lock
+   *
+   * @param k k
+   * @return std::optional<mapped_type> the value, empty if k is not found
+   */
+  std::optional<mapped_type> get(const key_type& k) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    const_iterator it = vec_lower_bound(k);
+    if (!hit(it, k)) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+#endif
+  /**
+   * @brief visit, call f on the value of k under the read lock
+   *
+   * @tparam F F
+   * @param k k
+   * @param f called as f(const mapped_type&); must not touch the map
+   * @return true k found, f called
+   * @return false k not found
+   */
+  template <class F>
+  bool visit(const key_type& k, F f) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    const_iterator it = vec_lower_bound(k);
+    if (!hit(it, k)) {
+      return false;
+    }
+    f(it->second);
+    return true;
+  }
+  /**
+   * @brief read_copy, see tsmap::read_copy
+   *
+   * @param k k
+   * @param value receives the value of k if found
+   * @return true k found
+   * @return false k not found, value untouched
+   */
+  bool read_copy(const key_type& k, mapped_type& value) const noexcept {
+    static_assert(std::is_trivially_copyable<mapped_type>::value,
+                  "read_copy needs a trivially copyable mapped_type");
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    const_iterator it = vec_lower_bound(k);
+    if (!hit(it, k)) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+  /**
+   * @brief call_each
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    std::for_each(vec.begin(), vec.end(), pred);
+  }
+  /**
+   * @brief call_range, call pred for every element with first <= key < last
+   * while holding the read lock
+   *
+   * @tparam P p
+   * @param first first
+   * @param last last
+   * @param pred pred
+   */
+  template <typename P>
+  void call_range(const key_type& first, const key_type& last,
+                  P pred) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    if (comp(last, first)) {
+      return;
+    }
+    std::for_each(vec_lower_bound(first), vec_lower_bound(last), pred);
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSFLATMAP_H__
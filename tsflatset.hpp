@@ -0,0 +1,235 @@
+#ifndef __TSFLATSET_H__
+#define __TSFLATSET_H__
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "atomic_rw_lock.h"
+#include "rw_lock_guard.h"
+namespace tscontainer {
+/**
+ * @brief tsflatset, set kept as one sorted std::vector, see tsflatmap; like
+ * there, no iterator leaves the lock, so test keys with count and scan with
+ * call_each or call_range
+ *
+ * @tparam Key key
+ * @tparam Compare compare
+ * @tparam std::allocator<Key> alloc
+ * @tparam RWLock lock policy, see tsset
+ */
+template <class Key, class Compare = std::less<Key>,
+          class Alloc = std::allocator<Key>,
+          class RWLock = base::AtomicRWLock>
+class tsflatset {
+ public:
+  // key_type
+  using key_type = Key;
+  // value_type
+  using value_type = Key;
+  // key_compare
+  using key_compare = Compare;
+  // vector
+  using vector = typename std::vector<value_type, Alloc>;
+  // size_type
+  using size_type = typename vector::size_type;
+
+ private:
+  // iterators stay inside: the vector may reallocate once the lock is gone
+  using const_iterator = typename vector::const_iterator;
+  // mtx
+  mutable RWLock mtx;
+  // vec, sorted, unique
+  vector vec;
+  // comp
+  key_compare comp;
+
+  const_iterator vec_lower_bound(const key_type& k) const noexcept {
+    return std::lower_bound(vec.begin(), vec.end(), k, comp);
+  }
+  bool hit(const_iterator it, const key_type& k) const noexcept {
+    return it != vec.end() && !comp(k, *it);
+  }
+  // Sorts v and drops duplicates.
+  void normalize(vector& v) const {
+    std::sort(v.begin(), v.end(), comp);
+    v.erase(std::unique(v.begin(), v.end(),
+                        [this](const value_type& a, const value_type& b) {
+                          return !comp(a, b);
+                        }),
+            v.end());
+  }
+
+ public:
+  /**
+   * @brief Construct a new tsflatset object
+   *
+   * @param comp compare
+   * @param alloc alloc
+   */
+  explicit tsflatset(const key_compare& comp = key_compare(),
+                     const Alloc& alloc = Alloc()) noexcept
+      : vec(alloc), comp(comp) {}
+  /**
+   * @brief Construct a new tsflatset object, sorting once
+   *
+   * @tparam InputIterator InputIterator
+   * @param first first
+   * @param last last
+   * @param comp comp
+   * @param alloc alloc
+   */
+  template <class InputIterator>
+  tsflatset(InputIterator first, InputIterator last,
+            const key_compare& comp = key_compare(),
+            const Alloc& alloc = Alloc())
+      : vec(first, last, alloc), comp(comp) {
+    normalize(vec);
+  }
+  /**
+   * @brief Construct a new tsflatset object
+   *
+   * @param il il
+   * @param comp comp
+   * @param alloc alloc
+   */
+  tsflatset(std::initializer_list<value_type> il,
+            const key_compare& comp = key_compare(),
+            const Alloc& alloc = Alloc())
+      : tsflatset(il.begin(), il.end(), comp, alloc) {}
+
+  tsflatset(const tsflatset&) = delete;
+  tsflatset& operator=(const tsflatset&) = delete;
+
+  /**
+   * @brief assign, replace the content, sorting once
+   *
+   * @tparam InputIterator InputIterator
+   * @param first first
+   * @param last last
+   */
+  template <class InputIterator>
+  void assign(InputIterator first, InputIterator last) noexcept {
+    vector next(first, last, vec.get_allocator());
+    normalize(next);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.swap(next);
+  }
+  /**
+   * @brief reserve
+   *
+   * @param n n
+   */
+  void reserve(size_type n) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.reserve(n);
+  }
+  /**
+   * @brief shrink_to_fit
+   *
+   */
+  void shrink_to_fit() noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.shrink_to_fit();
+  }
+  /**
+   * @brief empty
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return vec.empty();
+  }
+  /**
+   * @brief size
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return vec.size();
+  }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return true inserted
+   * @return false already present
+   */
+  bool insert(const value_type& val) noexcept {
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    const_iterator it = vec_lower_bound(val);
+    if (hit(it, val)) {
+      return false;
+    }
+    ulg.Upgrade();
+    vec.insert(it, val);
+    return true;
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    const_iterator it = vec_lower_bound(k);
+    if (!hit(it, k)) {
+      return 0;
+    }
+    vec.erase(it);
+    return 1;
+  }
+  /**
+   * @brief clear
+   *
+   */
+  void clear() noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    vec.clear();
+  }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return hit(vec_lower_bound(k), k) ? 1 : 0;
+  }
+  /**
+   * @brief call_each
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    std::for_each(vec.begin(), vec.end(), pred);
+  }
+  /**
+   * @brief call_range, call pred for every element with first <= key < last
+   * while holding the read lock
+   *
+   * @tparam P p
+   * @param first first
+   * @param last last
+   * @param pred pred
+   */
+  template <typename P>
+  void call_range(const key_type& first, const key_type& last,
+                  P pred) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    if (comp(last, first)) {
+      return;
+    }
+    std::for_each(vec_lower_bound(first), vec_lower_bound(last), pred);
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSFLATSET_H__
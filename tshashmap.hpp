@@ -0,0 +1,217 @@
+#ifndef __TSHASHMAP_H__
+#define __TSHASHMAP_H__
+#include <cstddef>
+#include <functional>
+#include <memory>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "tshashtable.hpp"
+namespace tscontainer {
+/**
+ * @brief tshashmap, unordered map with lock-striped buckets and incremental
+ * resizing, for keys that never need ordering
+ *
+ * Lookups and inserts are O(1) and lock only the stripe of the key; a
+ * stripe grows one bucket per insert, never the whole table at once. There
+ * are no iterators: pointers returned by find_or_emplace (and references
+ * returned by operator[]) stay valid until the element is erased, but, as
+ * with tsmap, are not protected once the call has finished.
+ *
+ * @tparam Key key
+ * @tparam T t
+ * @tparam Hash hash
+ * @tparam KeyEqual key equal
+ * @tparam std::allocator<std::pair<const Key, T>> alloc
+ * @tparam RWLock lock policy of every stripe
+ * @tparam StripeNum number of stripes
+ */
+template <class Key, class T, class Hash = std::hash<Key>,
+          class KeyEqual = std::equal_to<Key>,
+          class Alloc = std::allocator<std::pair<const Key, T>>,
+          class RWLock = base::AtomicRWLock, std::size_t StripeNum = 64>
+class tshashmap {
+ public:
+  // key_type
+  using key_type = Key;
+  // mapped_type
+  using mapped_type = T;
+  // value_type
+  using value_type = std::pair<const Key, T>;
+  // size_type
+  using size_type = std::size_t;
+
+ private:
+  struct key_of {
+    const Key& operator()(const value_type& v) const noexcept {
+      return v.first;
+    }
+  };
+  // table
+  detail::hash_table<value_type, Key, key_of, Hash, KeyEqual, Alloc, RWLock,
+                     StripeNum>
+      table;
+
+ public:
+  /**
+   * @brief Construct a new tshashmap object
+   *
+   */
+  tshashmap() = default;
+
+  tshashmap(const tshashmap&) = delete;
+  tshashmap& operator=(const tshashmap&) = delete;
+
+  /**
+   * @brief empty, without taking any lock
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return table.size() == 0; }
+  /**
+   * @brief size, sum of the per-stripe counters without taking any lock
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept { return table.size(); }
+  /**
+   * @brief operator[]
+   *
+   * @param k k
+   * @return mapped_type& mapped_type
+   */
+  mapped_type& operator[](const key_type& k) noexcept {
+    return find_or_emplace(k).first->second;
+  }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return true inserted
+   * @return false key already present
+   */
+  bool insert(const value_type& val) noexcept {
+    return table.find_or_emplace(val.first, val).second;
+  }
+  /**
+   * @brief find_or_emplace, see tsmap::find_or_emplace
+   *
+   * @tparam Args Args
+   * @param k k
+   * @param args arguments to construct the mapped value on a miss
+   * @return std::pair<value_type*, bool> std::pair, true if inserted
+   */
+  template <class... Args>
+  std::pair<value_type*, bool> find_or_emplace(const key_type& k,
+                                               Args&&... args) noexcept {
+    return table.find_or_emplace(
+        k, std::piecewise_construct, std::forward_as_tuple(k),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+  /**
+   * @brief find_or_insert
+   *
+   * @param val val
+   * @return std::pair<value_type*, bool> std::pair, true if inserted
+   */
+  std::pair<value_type*, bool> find_or_insert(const value_type& val) noexcept {
+    return table.find_or_emplace(val.first, val);
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept { return table.erase(k); }
+  /**
+   * @brief clear, one stripe after the other
+   *
+   */
+  void clear() noexcept { table.clear(); }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept { return table.count(k); }
+#if __cplusplus >= 201703L
+  /**
+   * @brief get, copy the value of k out under the read lock of its stripe
+   *
+   * @param k k
+   * @return std::optional<mapped_type> the value, empty if k is not found
+   */
+  std::optional<mapped_type> get(const key_type& k) const noexcept {
+    std::optional<mapped_type> value;
+    table.visit(k, [&value](const value_type& v) { value = v.second; });
+    return value;
+  }
+#endif
+  /**
+   * @brief visit, call f on the value of k under the read lock of its
+   * stripe
+   *
+   * @tparam F F
+   * @param k k
+   * @param f called as f(const mapped_type&); must not touch the map
+   * @return true k found, f called
+   * @return false k not found
+   */
+  template <class F>
+  bool visit(const key_type& k, F f) const noexcept {
+    return table.visit(k, [&f](const value_type& v) { f(v.second); });
+  }
+  /**
+   * @brief read_copy, see tsmap::read_copy; get() works for any
+   * mapped_type
+   *
+   * @param k k
+   * @param value receives the value of k if found
+   * @return true k found
+   * @return false k not found, value untouched
+   */
+  bool read_copy(const key_type& k, mapped_type& value) const noexcept {
+    static_assert(std::is_trivially_copyable<mapped_type>::value,
+                  "read_copy needs a trivially copyable mapped_type");
+    return table.visit(k, [&value](const value_type& v) { value = v.second; });
+  }
+  /**
+   * @brief try_insert, does not wait for the lock of the stripe
+   *
+   * @param val val
+   * @param inserted true if inserted, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_insert(const value_type& val, bool& inserted) noexcept {
+    return table.try_insert(val.first, val, inserted);
+  }
+  /**
+   * @brief try_erase, does not wait for the lock of the stripe
+   *
+   * @param k k
+   * @param count number of elements erased, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_erase(const key_type& k, size_type& count) noexcept {
+    return table.try_erase(k, count);
+  }
+  /**
+   * @brief call_each, visits the stripes in order, holding the read lock of
+   * one stripe at a time
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) noexcept {
+    table.call_each(pred);
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSHASHMAP_H__
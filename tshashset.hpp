@@ -0,0 +1,129 @@
+#ifndef __TSHASHSET_H__
+#define __TSHASHSET_H__
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include "tshashtable.hpp"
+namespace tscontainer {
+/**
+ * @brief tshashset, unordered set with lock-striped buckets and incremental
+ * resizing, for keys that never need ordering
+ *
+ * Lookups and inserts are O(1) and lock only the stripe of the key; a
+ * stripe grows one bucket per insert, never the whole table at once.
+ *
+ * @tparam Key key
+ * @tparam Hash hash
+ * @tparam KeyEqual key equal
+ * @tparam std::allocator<Key> alloc
+ * @tparam RWLock lock policy of every stripe
+ * @tparam StripeNum number of stripes
+ */
+template <class Key, class Hash = std::hash<Key>,
+          class KeyEqual = std::equal_to<Key>,
+          class Alloc = std::allocator<Key>,
+          class RWLock = base::AtomicRWLock, std::size_t StripeNum = 64>
+class tshashset {
+ public:
+  // key_type
+  using key_type = Key;
+  // value_type
+  using value_type = Key;
+  // size_type
+  using size_type = std::size_t;
+
+ private:
+  struct key_of {
+    const Key& operator()(const value_type& v) const noexcept { return v; }
+  };
+  // table
+  detail::hash_table<const value_type, Key, key_of, Hash, KeyEqual, Alloc,
+                     RWLock, StripeNum>
+      table;
+
+ public:
+  /**
+   * @brief Construct a new tshashset object
+   *
+   */
+  tshashset() = default;
+
+  tshashset(const tshashset&) = delete;
+  tshashset& operator=(const tshashset&) = delete;
+
+  /**
+   * @brief empty, without taking any lock
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return table.size() == 0; }
+  /**
+   * @brief size, sum of the per-stripe counters without taking any lock
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept { return table.size(); }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return true inserted
+   * @return false already present
+   */
+  bool insert(const value_type& val) noexcept {
+    return table.find_or_emplace(val, val).second;
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept { return table.erase(k); }
+  /**
+   * @brief clear, one stripe after the other
+   *
+   */
+  void clear() noexcept { table.clear(); }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept { return table.count(k); }
+  /**
+   * @brief try_insert, does not wait for the lock of the stripe
+   *
+   * @param val val
+   * @param inserted true if inserted, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_insert(const value_type& val, bool& inserted) noexcept {
+    return table.try_insert(val, val, inserted);
+  }
+  /**
+   * @brief try_erase, does not wait for the lock of the stripe
+   *
+   * @param k k
+   * @param count number of elements erased, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_erase(const key_type& k, size_type& count) noexcept {
+    return table.try_erase(k, count);
+  }
+  /**
+   * @brief call_each, visits the stripes in order, holding the read lock of
+   * one stripe at a time
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) noexcept {
+    table.call_each(pred);
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSHASHSET_H__
@@ -0,0 +1,272 @@
+#ifndef __TSHASHTABLE_H__
+#define __TSHASHTABLE_H__
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include "atomic_rw_lock.h"
+#include "rw_lock_guard.h"
+#include "tscommon.hpp"
+namespace tscontainer {
+namespace detail {
+/**
+ * @brief hash_table, lock-striped chained hash table behind tshashmap and
+ * tshashset
+ *
+ * A key goes to stripe hash % StripeNum. Every stripe has its own lock and
+ * its own bucket array, grown by linear hashing: each insert that pushes
+ * the load factor above one splits a single bucket, so the table grows a
+ * bucket at a time and no insert ever rehashes a whole stripe, let alone
+ * the whole table. Nodes never move, so pointers to values stay valid until
+ * the value is erased.
+ *
+ * @tparam Value stored value
+ * @tparam Key key
+ * @tparam KeyOf functor returning the key of a value
+ * @tparam Hash hash
+ * @tparam KeyEqual key equal
+ * @tparam Alloc allocator of Value, rebound to the node type
+ * @tparam RWLock lock policy of every stripe
+ * @tparam StripeNum number of stripes
+ */
+template <class Value, class Key, class KeyOf, class Hash, class KeyEqual,
+          class Alloc, class RWLock, std::size_t StripeNum>
+class hash_table {
+  static_assert(StripeNum > 0, "hash_table needs at least one stripe");
+
+ public:
+  // size_type
+  using size_type = std::size_t;
+  // initial number of buckets of every stripe
+  static const size_type INITIAL_BUCKET_NUM = 8;
+
+ private:
+  struct node {
+    template <class... Args>
+    node(size_type h, Args&&... args)
+        : hash(h), value(std::forward<Args>(args)...) {}
+    node* next = nullptr;
+    // hash / StripeNum, kept so splitting does not rehash
+    size_type hash;
+    Value value;
+  };
+  using node_alloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<node>;
+  using node_traits = std::allocator_traits<node_alloc>;
+
+  /**
+   * @brief stripe, padded so neighbouring locks do not share a cache line
+   *
+   */
+  struct alignas(base::CACHE_LINE_SIZE) stripe {
+    mutable RWLock mtx;
+    std::deque<node*> buckets = std::deque<node*>(INITIAL_BUCKET_NUM);
+    // linear hashing state: buckets.size() == (INITIAL_BUCKET_NUM << level)
+    // + split
+    size_type level = 0;
+    size_type split = 0;
+    // num, element count stored under the write lock, read without it
+    std::atomic<size_type> num = {0};
+  };
+  // stripes
+  stripe stripes[StripeNum];
+  node_alloc alloc;
+
+  static size_type hash_of(const Key& k) noexcept { return Hash()(k); }
+  stripe& stripe_of(size_type h) noexcept { return stripes[h % StripeNum]; }
+  const stripe& stripe_of(size_type h) const noexcept {
+    return stripes[h % StripeNum];
+  }
+  static size_type bucket_of(const stripe& s, size_type h) noexcept {
+    size_type base_num = INITIAL_BUCKET_NUM << s.level;
+    size_type b = h % base_num;
+    return b < s.split ? h % (base_num * 2) : b;
+  }
+  static node* const* find_in(const stripe& s, size_type h,
+                              const Key& k) noexcept {
+    node* const* link = &s.buckets[bucket_of(s, h)];
+    while (*link != nullptr &&
+           ((*link)->hash != h || !KeyEqual()(KeyOf()((*link)->value), k))) {
+      link = &(*link)->next;
+    }
+    return link;
+  }
+  static node** find_in(stripe& s, size_type h, const Key& k) noexcept {
+    return const_cast<node**>(
+        find_in(static_cast<const stripe&>(s), h, k));
+  }
+  // Splits the next bucket, moving the nodes that now hash past the old
+  // bucket range into the new bucket.
+  static void split_one(stripe& s) noexcept {
+    size_type base_num = INITIAL_BUCKET_NUM << s.level;
+    s.buckets.push_back(nullptr);
+    node** from = &s.buckets[s.split];
+    node** to = &s.buckets.back();
+    while (*from != nullptr) {
+      node* n = *from;
+      if (n->hash % (base_num * 2) != s.split) {
+        *from = n->next;
+        n->next = nullptr;
+        *to = n;
+        to = &n->next;
+      } else {
+        from = &n->next;
+      }
+    }
+    if (++s.split == base_num) {
+      s.level++;
+      s.split = 0;
+    }
+  }
+  template <class... Args>
+  node* link_new(stripe& s, node** link, size_type h, Args&&... args) {
+    node* n = node_traits::allocate(alloc, 1);
+    node_traits::construct(alloc, n, h, std::forward<Args>(args)...);
+    *link = n;
+    size_type num = s.num.load(std::memory_order_relaxed) + 1;
+    s.num.store(num, std::memory_order_relaxed);
+    if (num > s.buckets.size()) {
+      split_one(s);
+    }
+    return n;
+  }
+  void unlink(stripe& s, node** link) noexcept {
+    node* n = *link;
+    *link = n->next;
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+    s.num.store(s.num.load(std::memory_order_relaxed) - 1,
+                std::memory_order_relaxed);
+  }
+  void clear_stripe(stripe& s) noexcept {
+    for (node*& head : s.buckets) {
+      while (head != nullptr) {
+        node* n = head;
+        head = n->next;
+        node_traits::destroy(alloc, n);
+        node_traits::deallocate(alloc, n, 1);
+      }
+    }
+    s.buckets.assign(INITIAL_BUCKET_NUM, nullptr);
+    s.level = 0;
+    s.split = 0;
+    s.num.store(0, std::memory_order_relaxed);
+  }
+
+ public:
+  hash_table() = default;
+  ~hash_table() {
+    for (stripe& s : stripes) {
+      clear_stripe(s);
+    }
+  }
+  hash_table(const hash_table&) = delete;
+  hash_table& operator=(const hash_table&) = delete;
+
+  size_type size() const noexcept {
+    size_type total = 0;
+    for (const stripe& s : stripes) {
+      total += s.num.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+  size_type count(const Key& k) const noexcept {
+    size_type h = hash_of(k);
+    const stripe& s = stripe_of(h);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    return *find_in(s, h / StripeNum, k) != nullptr ? 1 : 0;
+  }
+  // Calls f(const Value&) with the value of k under the read lock.
+  template <typename F>
+  bool visit(const Key& k, F f) const noexcept {
+    size_type h = hash_of(k);
+    const stripe& s = stripe_of(h);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    node* n = *find_in(s, h / StripeNum, k);
+    if (n == nullptr) {
+      return false;
+    }
+    f(static_cast<const Value&>(n->value));
+    return true;
+  }
+  // Inserts Value(args...) unless k is present; returns the value of k.
+  template <class... Args>
+  std::pair<Value*, bool> find_or_emplace(const Key& k,
+                                          Args&&... args) noexcept {
+    size_type h = hash_of(k);
+    stripe& s = stripe_of(h);
+    base::UpgradeLockGuard<RWLock> ulg{s.mtx};
+    node** link = find_in(s, h / StripeNum, k);
+    if (*link != nullptr) {
+      return std::make_pair(&(*link)->value, false);
+    }
+    ulg.Upgrade();
+    node* n = link_new(s, link, h / StripeNum, std::forward<Args>(args)...);
+    return std::make_pair(&n->value, true);
+  }
+  // Same as find_or_emplace, but fails with would_block if the stripe is
+  // busy.
+  try_status try_insert(const Key& k, const Value& val,
+                        bool& inserted) noexcept {
+    size_type h = hash_of(k);
+    stripe& s = stripe_of(h);
+    base::WriteLockGuard<RWLock> wlg{s.mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    node** link = find_in(s, h / StripeNum, k);
+    inserted = *link == nullptr;
+    if (inserted) {
+      link_new(s, link, h / StripeNum, val);
+    }
+    return try_status::done;
+  }
+  size_type erase(const Key& k) noexcept {
+    size_type h = hash_of(k);
+    stripe& s = stripe_of(h);
+    base::WriteLockGuard<RWLock> wlg{s.mtx};
+    node** link = find_in(s, h / StripeNum, k);
+    if (*link == nullptr) {
+      return 0;
+    }
+    unlink(s, link);
+    return 1;
+  }
+  try_status try_erase(const Key& k, size_type& count) noexcept {
+    size_type h = hash_of(k);
+    stripe& s = stripe_of(h);
+    base::WriteLockGuard<RWLock> wlg{s.mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    node** link = find_in(s, h / StripeNum, k);
+    count = 0;
+    if (*link != nullptr) {
+      unlink(s, link);
+      count = 1;
+    }
+    return try_status::done;
+  }
+  void clear() noexcept {
+    for (stripe& s : stripes) {
+      base::WriteLockGuard<RWLock> wlg{s.mtx};
+      clear_stripe(s);
+    }
+  }
+  template <typename P>
+  void call_each(P pred) noexcept {
+    for (stripe& s : stripes) {
+      base::ReadLockGuard<RWLock> rlg{s.mtx};
+      for (node* head : s.buckets) {
+        for (node* n = head; n != nullptr; n = n->next) {
+          pred(n->value);
+        }
+      }
+    }
+  }
+};
+}  // namespace detail
+}  // namespace tscontainer
+#endif  // __TSHASHTABLE_H__
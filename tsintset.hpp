@@ -0,0 +1,669 @@
+#ifndef __TSINTSET_H__
+#define __TSINTSET_H__
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "atomic_rw_lock.h"
+#include "rw_lock_guard.h"
+namespace tscontainer {
+namespace detail {
+// Words of a bitmap chunk, one bit for each of the 65536 low values.
+const std::size_t BITMAP_WORDS = 1024;
+static_assert(BITMAP_WORDS % 4 == 0, "bitmaps are processed in whole vectors");
+
+/**
+ * @brief contains_u16, membership in a sorted uint16_t array; binary search
+ * narrows down to one vector, which is compared in a single instruction
+ *
+ */
+inline bool contains_u16(const uint16_t* a, std::size_t n, uint16_t x) {
+#if defined(__AVX2__)
+  const std::size_t lanes = 16;
+#else
+  const std::size_t lanes = 8;
+#endif
+  std::size_t lo = 0;
+  std::size_t hi = n;
+  while (hi - lo > lanes) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < x) {
+      lo = mid + 1;
+    } else {
+      hi = mid + 1;
+    }
+  }
+#if defined(__AVX2__)
+  if (n >= lanes) {
+    // one full vector covering [lo, hi), still inside the array
+    std::size_t start = std::min(lo, n - lanes);
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + start));
+    __m256i eq =
+        _mm256_cmpeq_epi16(v, _mm256_set1_epi16(static_cast<short>(x)));
+    return _mm256_movemask_epi8(eq) != 0;
+  }
+#elif defined(__SSE2__)
+  if (n >= lanes) {
+    std::size_t start = std::min(lo, n - lanes);
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + start));
+    __m128i eq = _mm_cmpeq_epi16(v, _mm_set1_epi16(static_cast<short>(x)));
+    return _mm_movemask_epi8(eq) != 0;
+  }
+#endif
+  for (std::size_t i = lo; i < hi; i++) {
+    if (a[i] == x) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief intersect_u16, out = a & b for sorted uint16_t arrays
+ *
+ * Compares one vector of a against every element of one vector of b, then
+ * moves on past the vector with the smaller maximum, so there is no
+ * data-dependent branch per element; the tails are merged one by one.
+ *
+ * @param out room for min(na, nb) values
+ * @return std::size_t number of values written to out
+ */
+inline std::size_t intersect_u16(const uint16_t* a, std::size_t na,
+                                 const uint16_t* b, std::size_t nb,
+                                 uint16_t* out) {
+  std::size_t i = 0;
+  std::size_t j = 0;
+  std::size_t n = 0;
+#if defined(__AVX2__)
+  const std::size_t lanes = 16;
+  while (i + lanes <= na && j + lanes <= nb) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i eq = _mm256_setzero_si256();
+    for (std::size_t k = 0; k < lanes; k++) {
+      eq = _mm256_or_si256(
+          eq, _mm256_cmpeq_epi16(
+                  va, _mm256_set1_epi16(static_cast<short>(b[j + k]))));
+    }
+    // one bit per lane, a's order is kept
+    uint32_t mask =
+        static_cast<uint32_t>(_mm256_movemask_epi8(eq)) & 0x55555555u;
+    for (; mask != 0; mask &= mask - 1) {
+      out[n++] = a[i + __builtin_ctz(mask) / 2];
+    }
+    uint16_t a_max = a[i + lanes - 1];
+    uint16_t b_max = b[j + lanes - 1];
+    i += a_max <= b_max ? lanes : 0;
+    j += b_max <= a_max ? lanes : 0;
+  }
+#elif defined(__SSE2__)
+  const std::size_t lanes = 8;
+  while (i + lanes <= na && j + lanes <= nb) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i eq = _mm_setzero_si128();
+    for (std::size_t k = 0; k < lanes; k++) {
+      eq = _mm_or_si128(
+          eq,
+          _mm_cmpeq_epi16(va, _mm_set1_epi16(static_cast<short>(b[j + k]))));
+    }
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eq)) & 0x5555u;
+    for (; mask != 0; mask &= mask - 1) {
+      out[n++] = a[i + __builtin_ctz(mask) / 2];
+    }
+    uint16_t a_max = a[i + lanes - 1];
+    uint16_t b_max = b[j + lanes - 1];
+    i += a_max <= b_max ? lanes : 0;
+    j += b_max <= a_max ? lanes : 0;
+  }
+#endif
+  // no value before i or j can match what is left
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (b[j] < a[i]) {
+      j++;
+    } else {
+      out[n++] = a[i];
+      i++;
+      j++;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief bitmap_and, dst &= src over a whole bitmap chunk
+ *
+ * @return uint32_t cardinality of the result
+ */
+inline uint32_t bitmap_and(uint64_t* dst, const uint64_t* src) {
+  std::size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= BITMAP_WORDS; i += 4) {
+    __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+    __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(d, _mm256_and_si256(_mm256_loadu_si256(d), s));
+  }
+#elif defined(__SSE2__)
+  for (; i + 2 <= BITMAP_WORDS; i += 2) {
+    __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(d, _mm_and_si128(_mm_loadu_si128(d), s));
+  }
+#else
+  for (; i < BITMAP_WORDS; i++) {
+    dst[i] &= src[i];
+  }
+#endif
+  uint32_t card = 0;
+  for (i = 0; i < BITMAP_WORDS; i++) {
+    card += __builtin_popcountll(dst[i]);
+  }
+  return card;
+}
+
+/**
+ * @brief bitmap_or, dst |= src over a whole bitmap chunk
+ *
+ * @return uint32_t cardinality of the result
+ */
+inline uint32_t bitmap_or(uint64_t* dst, const uint64_t* src) {
+  std::size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= BITMAP_WORDS; i += 4) {
+    __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+    __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(d, _mm256_or_si256(_mm256_loadu_si256(d), s));
+  }
+#elif defined(__SSE2__)
+  for (; i + 2 <= BITMAP_WORDS; i += 2) {
+    __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(d, _mm_or_si128(_mm_loadu_si128(d), s));
+  }
+#else
+  for (; i < BITMAP_WORDS; i++) {
+    dst[i] |= src[i];
+  }
+#endif
+  uint32_t card = 0;
+  for (i = 0; i < BITMAP_WORDS; i++) {
+    card += __builtin_popcountll(dst[i]);
+  }
+  return card;
+}
+}  // namespace detail
+
+/**
+ * @brief tsintset, compressed set of unsigned integers in the style of
+ * Roaring bitmaps
+ *
+ * Values are grouped by their high bits into chunks of 65536. A chunk holds
+ * up to ARRAY_MAX values as a sorted uint16_t array and switches to a 8 KiB
+ * bitmap above that, so a value costs at most 2 bytes plus a share of the
+ * chunk header. Membership uses SSE2/AVX2 compares on arrays and a bit test
+ * on bitmaps; intersection of arrays compares whole vectors against each
+ * other, and union and intersection of bitmaps run on whole vectors. The
+ * kernels are chosen at compile time with a scalar fallback. Batched
+ * inserts merge all values of a chunk at once. Locking follows tsset.
+ *
+ * @tparam UInt unsigned integer type, e.g. uint32_t or uint64_t
+ * @tparam RWLock lock policy, see tsset
+ */
+template <class UInt = uint32_t, class RWLock = base::AtomicRWLock>
+class tsintset {
+  static_assert(std::is_integral<UInt>::value && std::is_unsigned<UInt>::value,
+                "tsintset needs an unsigned integer type");
+
+ public:
+  // key_type
+  using key_type = UInt;
+  // value_type
+  using value_type = UInt;
+  // size_type
+  using size_type = std::size_t;
+  // largest array chunk, where an array and a bitmap take the same memory
+  static const uint32_t ARRAY_MAX = 4096;
+
+ private:
+  struct chunk {
+    // high bits of every value in the chunk
+    UInt key = 0;
+    uint32_t card = 0;
+    // sorted low bits, used while bitmap is empty
+    std::vector<uint16_t> array;
+    // detail::BITMAP_WORDS words once card exceeds ARRAY_MAX
+    std::vector<uint64_t> bitmap;
+
+    bool is_bitmap() const noexcept { return !bitmap.empty(); }
+    bool contains(uint16_t low) const noexcept {
+      if (is_bitmap()) {
+        return (bitmap[low >> 6] >> (low & 63)) & 1;
+      }
+      return detail::contains_u16(array.data(), array.size(), low);
+    }
+    void to_bitmap() {
+      bitmap.assign(detail::BITMAP_WORDS, 0);
+      for (uint16_t low : array) {
+        bitmap[low >> 6] |= uint64_t(1) << (low & 63);
+      }
+      std::vector<uint16_t>().swap(array);
+    }
+    void to_array() {
+      array.clear();
+      array.reserve(card);
+      for_each_low([this](uint16_t low) { array.push_back(low); });
+      std::vector<uint64_t>().swap(bitmap);
+    }
+    // Converts a bitmap that became small back to an array.
+    void shrink() {
+      if (is_bitmap() && card <= ARRAY_MAX) {
+        to_array();
+      }
+    }
+    bool insert(uint16_t low) {
+      if (is_bitmap()) {
+        uint64_t& word = bitmap[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if (word & bit) {
+          return false;
+        }
+        word |= bit;
+      } else {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (it != array.end() && *it == low) {
+          return false;
+        }
+        if (card == ARRAY_MAX) {
+          to_bitmap();
+          card++;
+          bitmap[low >> 6] |= uint64_t(1) << (low & 63);
+          return true;
+        }
+        array.insert(it, low);
+      }
+      card++;
+      return true;
+    }
+    // Inserts sorted, distinct lows in one merge.
+    void insert_sorted(const std::vector<uint16_t>& lows) {
+      if (!is_bitmap() && card + lows.size() > ARRAY_MAX) {
+        to_bitmap();
+      }
+      if (is_bitmap()) {
+        for (uint16_t low : lows) {
+          uint64_t& word = bitmap[low >> 6];
+          uint64_t bit = uint64_t(1) << (low & 63);
+          card += (word & bit) ? 0 : 1;
+          word |= bit;
+        }
+        // duplicates may have kept it small
+        shrink();
+        return;
+      }
+      std::vector<uint16_t> merged;
+      merged.reserve(array.size() + lows.size());
+      std::set_union(array.begin(), array.end(), lows.begin(), lows.end(),
+                     std::back_inserter(merged));
+      array.swap(merged);
+      card = static_cast<uint32_t>(array.size());
+    }
+    bool erase(uint16_t low) {
+      if (is_bitmap()) {
+        uint64_t& word = bitmap[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if (!(word & bit)) {
+          return false;
+        }
+        word &= ~bit;
+        card--;
+        shrink();
+        return true;
+      }
+      auto it = std::lower_bound(array.begin(), array.end(), low);
+      if (it == array.end() || *it != low) {
+        return false;
+      }
+      array.erase(it);
+      card--;
+      return true;
+    }
+    template <typename F>
+    void for_each_low(F f) const {
+      if (!is_bitmap()) {
+        for (uint16_t low : array) {
+          f(low);
+        }
+        return;
+      }
+      for (std::size_t i = 0; i < detail::BITMAP_WORDS; i++) {
+        for (uint64_t w = bitmap[i]; w != 0; w &= w - 1) {
+          f(static_cast<uint16_t>(i * 64 + __builtin_ctzll(w)));
+        }
+      }
+    }
+    void unite(const chunk& x) {
+      if (!x.is_bitmap()) {
+        insert_sorted(x.array);
+        return;
+      }
+      if (!is_bitmap()) {
+        to_bitmap();
+      }
+      card = detail::bitmap_or(bitmap.data(), x.bitmap.data());
+      shrink();
+    }
+    void intersect(const chunk& x) {
+      if (is_bitmap() && x.is_bitmap()) {
+        card = detail::bitmap_and(bitmap.data(), x.bitmap.data());
+        shrink();
+        return;
+      }
+      std::vector<uint16_t> kept;
+      if (!is_bitmap() && !x.is_bitmap()) {
+        kept.resize(std::min(array.size(), x.array.size()));
+        kept.resize(detail::intersect_u16(array.data(), array.size(),
+                                          x.array.data(), x.array.size(),
+                                          kept.data()));
+      } else {
+        const chunk& small = is_bitmap() ? x : *this;
+        const chunk& large = is_bitmap() ? *this : x;
+        for (uint16_t low : small.array) {
+          if (large.contains(low)) {
+            kept.push_back(low);
+          }
+        }
+      }
+      array.swap(kept);
+      std::vector<uint64_t>().swap(bitmap);
+      card = static_cast<uint32_t>(array.size());
+    }
+  };
+
+  // mtx
+  mutable RWLock mtx;
+  // chunks, sorted by key
+  std::vector<chunk> chunks;
+  // num
+  size_type num = 0;
+
+  static UInt high(UInt v) noexcept { return v >> 16; }
+  static uint16_t low(UInt v) noexcept { return static_cast<uint16_t>(v); }
+  typename std::vector<chunk>::iterator find_chunk(UInt key) noexcept {
+    return std::lower_bound(
+        chunks.begin(), chunks.end(), key,
+        [](const chunk& c, UInt k) { return c.key < k; });
+  }
+  typename std::vector<chunk>::const_iterator find_chunk(
+      UInt key) const noexcept {
+    return std::lower_bound(
+        chunks.begin(), chunks.end(), key,
+        [](const chunk& c, UInt k) { return c.key < k; });
+  }
+  bool contains(UInt v) const noexcept {
+    auto it = find_chunk(high(v));
+    return it != chunks.end() && it->key == high(v) && it->contains(low(v));
+  }
+  bool insert_locked(UInt v) {
+    auto it = find_chunk(high(v));
+    if (it == chunks.end() || it->key != high(v)) {
+      it = chunks.insert(it, chunk());
+      it->key = high(v);
+    }
+    if (!it->insert(low(v))) {
+      return false;
+    }
+    num++;
+    return true;
+  }
+  void recount() noexcept {
+    num = 0;
+    for (const chunk& c : chunks) {
+      num += c.card;
+    }
+  }
+
+ public:
+  /**
+   * @brief Construct a new tsintset object
+   *
+   */
+  tsintset() = default;
+
+  tsintset(const tsintset&) = delete;
+  tsintset& operator=(const tsintset&) = delete;
+
+  /**
+   * @brief empty
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return num == 0;
+  }
+  /**
+   * @brief size
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return num;
+  }
+  /**
+   * @brief memory_usage, bytes held by the chunks
+   *
+   * @return size_type bytes
+   */
+  size_type memory_usage() const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type bytes = chunks.capacity() * sizeof(chunk);
+    for (const chunk& c : chunks) {
+      bytes += c.array.capacity() * sizeof(uint16_t) +
+               c.bitmap.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+  }
+  /**
+   * @brief insert
+   *
+   * @param v v
+   * @return true inserted
+   * @return false already present
+   */
+  bool insert(UInt v) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    return insert_locked(v);
+  }
+  /**
+   * @brief insert_many, batched insert under one write lock; the values are
+   * sorted outside the lock, and all values of a chunk are merged into it
+   * at once
+   *
+   * @tparam InputIterator InputIterator
+   * @param first first
+   * @param last last
+   * @return size_type number of values inserted
+   */
+  template <class InputIterator>
+  size_type insert_many(InputIterator first, InputIterator last) noexcept {
+    std::vector<UInt> values(first, last);
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    std::vector<uint16_t> lows;
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type inserted = 0;
+    for (std::size_t i = 0; i < values.size();) {
+      UInt key = high(values[i]);
+      lows.clear();
+      for (; i < values.size() && high(values[i]) == key; i++) {
+        lows.push_back(low(values[i]));
+      }
+      auto it = find_chunk(key);
+      if (it == chunks.end() || it->key != key) {
+        it = chunks.insert(it, chunk());
+        it->key = key;
+      }
+      uint32_t before = it->card;
+      it->insert_sorted(lows);
+      inserted += it->card - before;
+    }
+    num += inserted;
+    return inserted;
+  }
+  /**
+   * @brief erase
+   *
+   * @param v v
+   * @return size_type size_type
+   */
+  size_type erase(UInt v) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    auto it = find_chunk(high(v));
+    if (it == chunks.end() || it->key != high(v) || !it->erase(low(v))) {
+      return 0;
+    }
+    if (it->card == 0) {
+      chunks.erase(it);
+    }
+    num--;
+    return 1;
+  }
+  /**
+   * @brief clear
+   *
+   */
+  void clear() noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    chunks.clear();
+    num = 0;
+  }
+  /**
+   * @brief count
+   *
+   * @param v v
+   * @return size_type size_type
+   */
+  size_type count(UInt v) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    return contains(v) ? 1 : 0;
+  }
+  /**
+   * @brief count_many, bulk membership under one read lock
+   *
+   * @param keys keys
+   * @param n number of keys
+   * @param found found[i] is set to whether keys[i] is present
+   * @return size_type number of keys present
+   */
+  size_type count_many(const UInt* keys, size_type n,
+                       bool* found) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type hits = 0;
+    auto it = chunks.end();
+    for (size_type i = 0; i < n; i++) {
+      // runs of keys in the same chunk skip the chunk lookup
+      if (it == chunks.end() || it->key != high(keys[i])) {
+        it = find_chunk(high(keys[i]));
+        if (it != chunks.end() && it->key != high(keys[i])) {
+          it = chunks.end();
+        }
+      }
+      found[i] = it != chunks.end() && it->contains(low(keys[i]));
+      hits += found[i] ? 1 : 0;
+    }
+    return hits;
+  }
+  /**
+   * @brief unite, *this |= x
+   *
+   * @param x x
+   */
+  void unite(const tsintset& x) noexcept {
+    if (&x == this) {
+      return;
+    }
+    std::vector<chunk> other;
+    {
+      // copy first, so the two locks are never held together
+      base::ReadLockGuard<RWLock> rlg{x.mtx};
+      other = x.chunks;
+    }
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    std::vector<chunk> merged;
+    merged.reserve(chunks.size() + other.size());
+    auto a = chunks.begin();
+    auto b = other.begin();
+    while (a != chunks.end() || b != other.end()) {
+      if (b == other.end() || (a != chunks.end() && a->key < b->key)) {
+        merged.push_back(std::move(*a++));
+      } else if (a == chunks.end() || b->key < a->key) {
+        merged.push_back(std::move(*b++));
+      } else {
+        a->unite(*b++);
+        merged.push_back(std::move(*a++));
+      }
+    }
+    chunks.swap(merged);
+    recount();
+  }
+  /**
+   * @brief intersect, *this &= x
+   *
+   * @param x x
+   */
+  void intersect(const tsintset& x) noexcept {
+    if (&x == this) {
+      return;
+    }
+    std::vector<chunk> other;
+    {
+      base::ReadLockGuard<RWLock> rlg{x.mtx};
+      other = x.chunks;
+    }
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    std::vector<chunk> kept;
+    auto b = other.begin();
+    for (chunk& c : chunks) {
+      while (b != other.end() && b->key < c.key) {
+        b++;
+      }
+      if (b == other.end() || b->key != c.key) {
+        continue;
+      }
+      c.intersect(*b);
+      if (c.card != 0) {
+        kept.push_back(std::move(c));
+      }
+    }
+    chunks.swap(kept);
+    recount();
+  }
+  /**
+   * @brief call_each, in ascending order while holding the read lock
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    for (const chunk& c : chunks) {
+      UInt base_value = c.key << 16;
+      c.for_each_low(
+          [&](uint16_t low) { pred(static_cast<UInt>(base_value | low)); });
+    }
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSINTSET_H__
@@ -1,13 +1,28 @@
 #ifndef __TSMAP_H__
 #define __TSMAP_H__
 #include <algorithm>
+#include <atomic>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+#include <tuple>
+#include <type_traits>
 #include <utility>
-#include "atomic_rw_lock.hpp"
-#include "rw_lock_guard.hpp"
+#include <vector>
+#include "atomic_rw_lock.h"
+#include "co_rw_lock.h"
+#include "rw_lock_guard.h"
+#include "tscombine.hpp"
+#include "tscommon.hpp"
+#include "tsfeed.hpp"
+#include "tsparallel.hpp"
+#include "tssnapshot.hpp"
 namespace tscontainer {
 /**
  * @brief tsmap
@@ -16,10 +31,15 @@ namespace tscontainer {
  * @tparam T t
  * @tparam Compare compare
  * @tparam std::allocator<std::pair<const Key, T>> alloc
+ * @tparam RWLock lock policy, any type usable with base::ReadLockGuard and
+ * base::WriteLockGuard (e.g. base::NullRWLock, base::MutexRWLock<>,
+ * base::SharedMutexRWLock<>)
  */
 template <class Key, class T, class Compare = std::less<Key>,
-          class Alloc = std::allocator<std::pair<const Key, T>>>
+          class Alloc = std::allocator<std::pair<const Key, T>>,
+          class RWLock = base::AtomicRWLock>
 class tsmap : public std::map<Key, T, Compare, Alloc> {
+ public:
   // iterator
   using iterator = typename std::map<Key, T, Compare, Alloc>::iterator;
   // const_iterator
@@ -40,8 +60,126 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
   using size_type = typename std::map<Key, T, Compare, Alloc>::size_type;
   // map
   using map = typename std::map<Key, T, Compare, Alloc>;
+  // change
+  using change = change_event<Key, T>;
+  // subscription
+  using subscription = change_subscription<Key, T>;
+
+ private:
   // mtx
-  mutable base::AtomicRWLock mtx;
+  mutable RWLock mtx;
+  // operation posted by the combined_* methods
+  struct combined_op {
+    batch_op op;
+    const key_type* key;
+    // nullptr for erase
+    const mapped_type* value;
+    bool result;
+  };
+  // created by the first combined_* call, so other maps pay one pointer
+  std::atomic<detail::flat_combiner<combined_op>*> combiner = {nullptr};
+  // change feed, created by the first subscribe(); guarded by mtx
+  std::shared_ptr<detail::change_ring<Key, T>> feed;
+
+  // Record a change for the subscribers; called under the write lock.
+  void publish(change_op op, const_iterator it) noexcept {
+    if (feed) {
+      feed->publish(op, &it->first,
+                    op == change_op::erase ? nullptr : &it->second);
+    }
+  }
+  void publish(change_op op) noexcept {
+    if (feed) {
+      feed->publish(op, nullptr, nullptr);
+    }
+  }
+  // The content was replaced wholesale; subscribers have to resync.
+  void publish_reset() noexcept {
+    if (feed) {
+      feed->reset();
+    }
+  }
+  // Insert and publish; called under the write lock, by insert and
+  // async_insert alike.
+  std::pair<iterator, bool> insert_locked(const value_type& val) noexcept {
+    std::pair<iterator, bool> r =
+        this->std::map<Key, T, Compare, Alloc>::insert(val);
+    if (r.second) {
+      publish(change_op::insert, r.first);
+    }
+    return r;
+  }
+
+  /**
+   * @brief sweep_keys, resolve keys to their lower_bound; f(i, it, hit) is
+   * called once for each keys[i]
+   *
+   * Keys are sorted in blocks of SWEEP_BLOCK indexes on the stack. Each key
+   * first steps forward from the previous one, which is cheap for nearby
+   * keys. Keys farther than SWEEP_STEPS elements away are set aside and
+   * descend the tree DESCENT_GROUP at a time with prefetching, see
+   * detail::group_lower_bound, so f is not called in key order.
+   */
+  template <class Self, class F>
+  static void sweep_keys(Self& self, const key_type* keys, size_type n,
+                         F f) noexcept {
+    const size_type SWEEP_BLOCK = 64;
+    const size_type SWEEP_STEPS = 4;
+    key_compare comp = self.key_comp();
+    auto key_of = [](const value_type& v) -> const key_type& {
+      return v.first;
+    };
+    auto end = self.end();
+    using iter = decltype(end);
+    size_type order[SWEEP_BLOCK];
+    // far keys waiting for a group descent
+    size_type far[detail::DESCENT_GROUP];
+    const key_type* far_keys[detail::DESCENT_GROUP];
+    iter far_its[detail::DESCENT_GROUP];
+    size_type far_num = 0;
+    auto descend = [&]() {
+      detail::group_lower_bound(self, far_keys, far_num, key_of, comp,
+                                far_its);
+      for (size_type g = 0; g < far_num; g++) {
+        iter it = far_its[g];
+        f(far[g], it, it != end && !comp(*far_keys[g], it->first));
+      }
+      // the lower_bound of the largest key, a valid hint for the next ones
+      iter last = far_its[far_num - 1];
+      far_num = 0;
+      return last;
+    };
+    for (size_type first = 0; first < n; first += SWEEP_BLOCK) {
+      size_type m = std::min(SWEEP_BLOCK, n - first);
+      for (size_type j = 0; j < m; j++) {
+        order[j] = first + j;
+      }
+      std::sort(order, order + m, [keys, &comp](size_type a, size_type b) {
+        return comp(keys[a], keys[b]);
+      });
+      iter hint = self.begin();
+      for (size_type j = 0; j < m; j++) {
+        const key_type& k = keys[order[j]];
+        for (size_type step = 0;
+             step < SWEEP_STEPS && hint != end && comp(hint->first, k);
+             step++) {
+          ++hint;
+        }
+        if (hint != end && comp(hint->first, k)) {
+          far[far_num] = order[j];
+          far_keys[far_num] = &k;
+          if (++far_num == detail::DESCENT_GROUP) {
+            hint = descend();
+          }
+          continue;
+        }
+        f(order[j], hint, hint != end && !comp(k, hint->first));
+      }
+      if (far_num != 0) {
+        descend();
+      }
+    }
+  }
 
  public:
   /**
@@ -133,62 +271,72 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
         const key_compare& comp = key_compare(),
         const allocator_type& alloc = allocator_type())
       : std::map<Key, T, Compare, Alloc>(il, comp, alloc) {}
+  /**
+   * @brief Destroy the tsmap object
+   *
+   */
+  ~tsmap() { delete combiner.load(); }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsmap<Key, T, Compare, Alloc>& tsmap
+   * @return tsmap<Key, T, Compare, Alloc, RWLock>& tsmap
    */
-  tsmap<Key, T, Compare, Alloc>& operator=(const map& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsmap<Key, T, Compare, Alloc, RWLock>& operator=(const map& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsmap<Key, T, Compare, Alloc>& tsmap
+   * @return tsmap<Key, T, Compare, Alloc, RWLock>& tsmap
    */
-  tsmap<Key, T, Compare, Alloc>& operator=(
-      const tsmap<Key, T, Compare, Alloc>& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsmap<Key, T, Compare, Alloc, RWLock>& operator=(
+      const tsmap<Key, T, Compare, Alloc, RWLock>& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsmap<Key, T, Compare, Alloc>& tsmap
+   * @return tsmap<Key, T, Compare, Alloc, RWLock>& tsmap
    */
-  tsmap<Key, T, Compare, Alloc>& operator=(map&& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsmap<Key, T, Compare, Alloc, RWLock>& operator=(map&& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsmap<Key, T, Compare, Alloc>& tsmap
+   * @return tsmap<Key, T, Compare, Alloc, RWLock>& tsmap
    */
-  tsmap<Key, T, Compare, Alloc>& operator=(
-      tsmap<Key, T, Compare, Alloc>&& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsmap<Key, T, Compare, Alloc, RWLock>& operator=(
+      tsmap<Key, T, Compare, Alloc, RWLock>&& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param il il
-   * @return tsmap<Key, T, Compare, Alloc>& tsmap
+   * @return tsmap<Key, T, Compare, Alloc, RWLock>& tsmap
    */
-  tsmap<Key, T, Compare, Alloc>& operator=(
+  tsmap<Key, T, Compare, Alloc, RWLock>& operator=(
       std::initializer_list<value_type> il) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::operator=(il);
+    publish_reset();
     return *this;
   }
   /**
@@ -198,7 +346,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return false false
    */
   bool empty() const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::empty();
   }
   /**
@@ -207,18 +355,30 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return size_type size
    */
   size_type size() const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::size();
   }
   /**
    * @brief operator[]
    *
+   * A hit only holds the upgradable lock, so it does not block readers; a
+   * miss upgrades in place and inserts at the position already found.
+   *
    * @param k k
    * @return mapped_type&
    */
   mapped_type& operator[](const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::operator[](k);
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end() ||
+        this->key_comp()(k, it->first)) {
+      ulg.Upgrade();
+      it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(
+          it, std::piecewise_construct, std::forward_as_tuple(k),
+          std::forward_as_tuple());
+      publish(change_op::insert, it);
+    }
+    return it->second;
   }
   /**
    * @brief operator[]
@@ -227,8 +387,17 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return mapped_type& mapped_type
    */
   mapped_type& operator[](key_type&& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::operator[](k);
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end() ||
+        this->key_comp()(k, it->first)) {
+      ulg.Upgrade();
+      it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(
+          it, std::piecewise_construct, std::forward_as_tuple(std::move(k)),
+          std::forward_as_tuple());
+      publish(change_op::insert, it);
+    }
+    return it->second;
   }
   /**
    * @brief at
@@ -237,7 +406,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return mapped_type& mapped_type
    */
   mapped_type& at(const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::ReadLockGuard<RWLock> wlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::at(k);
   }
 
@@ -248,7 +417,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return const mapped_type& const mapped_type
    */
   const mapped_type& at(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::ReadLockGuard<RWLock> wlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::at(k);
   }
   /**
@@ -258,8 +427,8 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return std::pair<iterator, bool> std::pair
    */
   std::pair<iterator, bool> insert(const value_type& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::insert(val);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    return insert_locked(val);
   }
   /**
    * @brief insert
@@ -268,8 +437,13 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return std::pair<iterator, bool> std::pair
    */
   std::pair<iterator, bool> insert(value_type&& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::insert(std::move(val));
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    std::pair<iterator, bool> r =
+        this->std::map<Key, T, Compare, Alloc>::insert(std::move(val));
+    if (r.second) {
+      publish(change_op::insert, r.first);
+    }
+    return r;
   }
   /**
    * @brief insert
@@ -279,8 +453,13 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator insert(iterator position, const value_type& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::insert(position, val);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type before = this->std::map<Key, T, Compare, Alloc>::size();
+    iterator it = this->std::map<Key, T, Compare, Alloc>::insert(position, val);
+    if (this->std::map<Key, T, Compare, Alloc>::size() != before) {
+      publish(change_op::insert, it);
+    }
+    return it;
   }
   /**
    * @brief insert
@@ -290,9 +469,14 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator insert(iterator position, value_type&& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::insert(position,
-                                                          std::move(val));
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type before = this->std::map<Key, T, Compare, Alloc>::size();
+    iterator it = this->std::map<Key, T, Compare, Alloc>::insert(position,
+                                                               std::move(val));
+    if (this->std::map<Key, T, Compare, Alloc>::size() != before) {
+      publish(change_op::insert, it);
+    }
+    return it;
   }
   /**
    * @brief insert
@@ -303,8 +487,53 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    */
   template <class InputIterator>
   void insert(InputIterator first, InputIterator last) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::insert(first, last);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    if (!feed) {
+      return this->std::map<Key, T, Compare, Alloc>::insert(first, last);
+    }
+    for (; first != last; ++first) {
+      std::pair<iterator, bool> r =
+          this->std::map<Key, T, Compare, Alloc>::insert(*first);
+      if (r.second) {
+        publish(change_op::insert, r.first);
+      }
+    }
+  }
+  /**
+   * @brief find_or_emplace
+   *
+   * Atomic "look up, insert if missing": a hit only holds the upgradable
+   * lock, a miss upgrades in place and inserts without a second lookup.
+   *
+   * @tparam Args Args
+   * @param k k
+   * @param args arguments to construct the mapped value on a miss
+   * @return std::pair<iterator, bool> std::pair, true if inserted
+   */
+  template <class... Args>
+  std::pair<iterator, bool> find_or_emplace(const key_type& k,
+                                            Args&&... args) noexcept {
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
+    if (it != this->std::map<Key, T, Compare, Alloc>::end() &&
+        !this->key_comp()(k, it->first)) {
+      return std::make_pair(it, false);
+    }
+    ulg.Upgrade();
+    it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(
+        it, std::piecewise_construct, std::forward_as_tuple(k),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    publish(change_op::insert, it);
+    return std::make_pair(it, true);
+  }
+  /**
+   * @brief find_or_insert
+   *
+   * @param val val
+   * @return std::pair<iterator, bool> std::pair, true if inserted
+   */
+  std::pair<iterator, bool> find_or_insert(const value_type& val) noexcept {
+    return find_or_emplace(val.first, val.second);
   }
   /**
    * @brief erase
@@ -313,7 +542,8 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator erase(const_iterator position) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    publish(change_op::erase, position);
     return this->std::map<Key, T, Compare, Alloc>::erase(position);
   }
   /**
@@ -323,8 +553,15 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return size_type size_type
    */
   size_type erase(const key_type& k) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::erase(k);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end()) {
+      return 0;
+    }
+    // before the erase, k may refer to the erased key
+    publish(change_op::erase, it);
+    this->std::map<Key, T, Compare, Alloc>::erase(it);
+    return 1;
   }
   /**
    * @brief erase
@@ -334,7 +571,12 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator erase(const_iterator first, const_iterator last) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    if (feed) {
+      for (const_iterator it = first; it != last; ++it) {
+        publish(change_op::erase, it);
+      }
+    }
     return this->std::map<Key, T, Compare, Alloc>::erase(first, last);
   }
   /**
@@ -343,25 +585,28 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @param x x
    */
   void swap(map& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::swap(x);
+    publish_reset();
   }
   /**
    * @brief swap
    *
    * @param x x
    */
-  void swap(tsmap<Key, T, Compare, Alloc>& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  void swap(tsmap<Key, T, Compare, Alloc, RWLock>& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::swap(x);
+    publish_reset();
   }
   /**
    * @brief clear
    *
    */
   void clear() noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::map<Key, T, Compare, Alloc>::clear();
+    publish(change_op::clear);
   }
   /**
    * @brief emplace
@@ -372,8 +617,13 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    */
   template <class... Args>
   std::pair<iterator, bool> emplace(Args&&... args) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::emplace(args...);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    std::pair<iterator, bool> r =
+        this->std::map<Key, T, Compare, Alloc>::emplace(args...);
+    if (r.second) {
+      publish(change_op::insert, r.first);
+    }
+    return r;
   }
   /**
    * @brief emplace_hint
@@ -385,9 +635,14 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    */
   template <class... Args>
   iterator emplace_hint(const_iterator position, Args&&... args) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::map<Key, T, Compare, Alloc>::emplace_hint(position,
-                                                                args...);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type before = this->std::map<Key, T, Compare, Alloc>::size();
+    iterator it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(position,
+                                                                     args...);
+    if (this->std::map<Key, T, Compare, Alloc>::size() != before) {
+      publish(change_op::insert, it);
+    }
+    return it;
   }
   /**
    * @brief find
@@ -396,7 +651,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator find(const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::find(k);
   }
   /**
@@ -406,9 +661,161 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return const_iterator const_iterator
    */
   const_iterator find(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::find(k);
   }
+  /**
+   * @brief read_copy, get() with an out parameter, for trivially copyable
+   * values
+   *
+   * The same locked find and copy as get() and get_or(), not an optimistic
+   * read: it takes the read lock like any other reader. Only the lock
+   * decides what that costs; with base::DistRWLock the read lock writes no
+   * cache line shared with other readers.
+   *
+   * @param k k
+   * @param value receives the value of k if found
+   * @return true k found
+   * @return false k not found, value untouched
+   */
+  bool read_copy(const key_type& k, mapped_type& value) const noexcept {
+    static_assert(std::is_trivially_copyable<mapped_type>::value,
+                  "read_copy needs a trivially copyable mapped_type");
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    auto it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+#if __cplusplus >= 201703L
+  /**
+   * @brief get, copy the value of k out under the read lock
+   *
+   * @param k k
+   * @return std::optional<mapped_type> the value, empty if k is not found
+   */
+  std::optional<mapped_type> get(const key_type& k) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    auto it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+#endif
+  /**
+   * @brief get_or, copy the value of k out under the read lock
+   *
+   * @param k k
+   * @param def returned if k is not found
+   * @return mapped_type the value of k, or def
+   */
+  mapped_type get_or(const key_type& k, const mapped_type& def) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    auto it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end()) {
+      return def;
+    }
+    return it->second;
+  }
+  /**
+   * @brief upsert, insert k or overwrite its value
+   *
+   * @param k k
+   * @param value value
+   * @return true inserted
+   * @return false overwritten
+   */
+  bool upsert(const key_type& k, const mapped_type& value) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
+    if (it != this->std::map<Key, T, Compare, Alloc>::end() &&
+        !this->key_comp()(k, it->first)) {
+      it->second = value;
+      publish(change_op::assign, it);
+      return false;
+    }
+    it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(it, k, value);
+    publish(change_op::insert, it);
+    return true;
+  }
+  /**
+   * @brief compute, call fn(value) on the value of k under the write lock,
+   * inserting a value-initialized mapped_type first if k is missing
+   *
+   * @tparam F F
+   * @param k k
+   * @param fn called as fn(mapped_type&)
+   * @return true k was inserted
+   * @return false k was present
+   */
+  template <class F>
+  bool compute(const key_type& k, F fn) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
+    bool inserted = false;
+    if (it == this->std::map<Key, T, Compare, Alloc>::end() ||
+        this->key_comp()(k, it->first)) {
+      it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(
+          it, std::piecewise_construct, std::forward_as_tuple(k),
+          std::forward_as_tuple());
+      inserted = true;
+    }
+    fn(it->second);
+    publish(inserted ? change_op::insert : change_op::assign, it);
+    return inserted;
+  }
+  /**
+   * @brief compute_if_present, call fn(value) on the value of k if found
+   *
+   * The lookup holds the upgradable lock, so a miss never blocks readers;
+   * a hit upgrades in place before fn runs.
+   *
+   * @tparam F F
+   * @param k k
+   * @param fn called as fn(mapped_type&)
+   * @return true k found, fn called
+   * @return false k not found
+   */
+  template <class F>
+  bool compute_if_present(const key_type& k, F fn) noexcept {
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end()) {
+      return false;
+    }
+    ulg.Upgrade();
+    fn(it->second);
+    publish(change_op::assign, it);
+    return true;
+  }
+  /**
+   * @brief erase_if, erase k if pred(value) holds
+   *
+   * pred runs under the upgradable lock next to readers; only an erase
+   * upgrades to the write lock.
+   *
+   * @tparam P P
+   * @param k k
+   * @param pred called as pred(const mapped_type&)
+   * @return true k erased
+   * @return false k not found or pred false
+   */
+  template <class P>
+  bool erase_if(const key_type& k, P pred) noexcept {
+    base::UpgradeLockGuard<RWLock> ulg{mtx};
+    iterator it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    if (it == this->std::map<Key, T, Compare, Alloc>::end() ||
+        !pred(static_cast<const mapped_type&>(it->second))) {
+      return false;
+    }
+    ulg.Upgrade();
+    publish(change_op::erase, it);
+    this->std::map<Key, T, Compare, Alloc>::erase(it);
+    return true;
+  }
   /**
    * @brief count
    *
@@ -416,7 +823,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return size_type size_type
    */
   size_type count(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::count(k);
   }
   /**
@@ -426,7 +833,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator lower_bound(const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
   }
   /**
@@ -436,7 +843,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return const_iterator const_iterator
    */
   const_iterator lower_bound(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
   }
   /**
@@ -446,7 +853,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return iterator iterator
    */
   iterator upper_bound(const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::upper_bound(k);
   }
   /**
@@ -456,7 +863,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return const_iterator const_iterator
    */
   const_iterator upper_bound(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::upper_bound(k);
   }
   /**
@@ -467,7 +874,7 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    */
   std::pair<const_iterator, const_iterator> equal_range(
       const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::equal_range(k);
   }
   /**
@@ -477,9 +884,526 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    * @return std::pair<iterator, iterator> std::pair
    */
   std::pair<iterator, iterator> equal_range(const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::map<Key, T, Compare, Alloc>::equal_range(k);
   }
+  /**
+   * @brief try_find, does not wait for the lock
+   *
+   * @param k k
+   * @param it set to the element found or end(), untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_find(const key_type& k, iterator& it) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx, std::try_to_lock};
+    if (!rlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    return try_status::done;
+  }
+  /**
+   * @brief try_find, does not wait for the lock
+   *
+   * @param k k
+   * @param it set to the element found or end(), untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_find(const key_type& k, const_iterator& it) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx, std::try_to_lock};
+    if (!rlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    return try_status::done;
+  }
+  /**
+   * @brief try_insert, does not wait for the lock
+   *
+   * @param val val
+   * @param result result of insert, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_insert(const value_type& val,
+                        std::pair<iterator, bool>& result) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    result = this->std::map<Key, T, Compare, Alloc>::insert(val);
+    if (result.second) {
+      publish(change_op::insert, result.first);
+    }
+    return try_status::done;
+  }
+  /**
+   * @brief try_erase, does not wait for the lock
+   *
+   * @param k k
+   * @param count number of elements erased, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_erase(const key_type& k, size_type& count) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    iterator it = this->std::map<Key, T, Compare, Alloc>::find(k);
+    count = it != this->std::map<Key, T, Compare, Alloc>::end() ? 1 : 0;
+    if (count != 0) {
+      publish(change_op::erase, it);
+      this->std::map<Key, T, Compare, Alloc>::erase(it);
+    }
+    return try_status::done;
+  }
+  /**
+   * @brief find_many, find all keys under one read lock
+   *
+   * @param keys keys
+   * @param n number of keys
+   * @param out out[i] receives find(keys[i]); like find, the iterators are
+   * not protected once the call has finished
+   * @return size_type number of keys found
+   */
+  size_type find_many(const key_type* keys, size_type n,
+                      iterator* out) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type hits = 0;
+    map& self = *this;
+    iterator end = self.end();
+    sweep_keys(self, keys, n, [&](size_type i, iterator it, bool hit) {
+      out[i] = hit ? it : end;
+      hits += hit ? 1 : 0;
+    });
+    return hits;
+  }
+  /**
+   * @brief count_many, look up all keys under one read lock
+   *
+   * @param keys keys
+   * @param n number of keys
+   * @param found found[i] is set to whether keys[i] is present
+   * @return size_type number of keys found
+   */
+  size_type count_many(const key_type* keys, size_type n,
+                       bool* found) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type hits = 0;
+    sweep_keys(static_cast<const map&>(*this), keys, n,
+               [&](size_type i, const_iterator, bool hit) {
+                 found[i] = hit;
+                 hits += hit ? 1 : 0;
+               });
+    return hits;
+  }
+  /**
+   * @brief get_many, copy the values of all keys out under one read lock
+   *
+   * @param keys keys
+   * @param n number of keys
+   * @param values values[i] receives the value of keys[i] if found,
+   * otherwise it is left untouched
+   * @param found found[i] is set to whether keys[i] is present
+   * @return size_type number of keys found
+   */
+  size_type get_many(const key_type* keys, size_type n, mapped_type* values,
+                     bool* found) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type hits = 0;
+    sweep_keys(static_cast<const map&>(*this), keys, n,
+               [&](size_type i, const_iterator it, bool hit) {
+                 if (hit) {
+                   values[i] = it->second;
+                 }
+                 found[i] = hit;
+                 hits += hit ? 1 : 0;
+               });
+    return hits;
+  }
+  /**
+   * @brief batch_entry, one operation of apply_batch
+   *
+   */
+  struct batch_entry {
+    batch_op op;
+    key_type key;
+    // ignored by erase
+    mapped_type value;
+  };
+  /**
+   * @brief apply_batch, apply many operations under one write lock
+   *
+   * The operations are sorted by key before the lock is taken (operations
+   * on the same key keep their order) and applied in one pass, each
+   * starting from where the previous one left off, so most of them need
+   * no tree descent.
+   *
+   * @param ops ops
+   * @param n number of operations
+   * @param results results[i] receives the result of ops[i], see batch_op;
+   * may be nullptr
+   * @return size_type number of operations with a true result
+   */
+  size_type apply_batch(const batch_entry* ops, size_type n,
+                        bool* results = nullptr) noexcept {
+    std::vector<size_type> order(n);
+    for (size_type i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    key_compare comp = this->key_comp();
+    std::stable_sort(order.begin(), order.end(),
+                     [ops, &comp](size_type a, size_type b) {
+                       return comp(ops[a].key, ops[b].key);
+                     });
+    size_type done = 0;
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator end = this->std::map<Key, T, Compare, Alloc>::end();
+    // lower_bound of the previous key, so of every key before the next one
+    iterator hint = this->std::map<Key, T, Compare, Alloc>::begin();
+    for (size_type i : order) {
+      const batch_entry& e = ops[i];
+      if (hint != end && comp(hint->first, e.key)) {
+        ++hint;
+        if (hint != end && comp(hint->first, e.key)) {
+          hint = this->std::map<Key, T, Compare, Alloc>::lower_bound(e.key);
+        }
+      }
+      bool found = hint != end && !comp(e.key, hint->first);
+      bool result = false;
+      if (e.op == batch_op::erase) {
+        if (found) {
+          publish(change_op::erase, hint);
+          hint = this->std::map<Key, T, Compare, Alloc>::erase(hint);
+          result = true;
+        }
+      } else if (!found) {
+        hint = this->std::map<Key, T, Compare, Alloc>::emplace_hint(
+            hint, e.key, e.value);
+        publish(change_op::insert, hint);
+        result = true;
+      } else if (e.op == batch_op::assign) {
+        hint->second = e.value;
+        publish(change_op::assign, hint);
+      }
+      if (results != nullptr) {
+        results[i] = result;
+      }
+      done += result ? 1 : 0;
+    }
+    return done;
+  }
+  /**
+   * @brief combined_insert, insert through the flat-combining write path
+   *
+   * The combined_* methods post the operation and let a single combiner
+   * take the write lock and apply all posted operations in one pass, see
+   * detail::flat_combiner. Under many concurrent writers this beats taking
+   * the write lock per call; with few writers prefer the plain methods.
+   *
+   * @param k k
+   * @param value value
+   * @return true inserted
+   * @return false k already present, nothing changed
+   */
+  bool combined_insert(const key_type& k, const mapped_type& value) noexcept {
+    return combined(batch_op::insert, k, &value);
+  }
+  /**
+   * @brief combined_assign, insert or overwrite through the flat-combining
+   * write path
+   *
+   * @param k k
+   * @param value value
+   * @return true inserted
+   * @return false overwritten
+   */
+  bool combined_assign(const key_type& k, const mapped_type& value) noexcept {
+    return combined(batch_op::assign, k, &value);
+  }
+  /**
+   * @brief combined_erase, erase through the flat-combining write path
+   *
+   * @param k k
+   * @return true erased
+   * @return false k not found
+   */
+  bool combined_erase(const key_type& k) noexcept {
+    return combined(batch_op::erase, k, nullptr);
+  }
+
+ private:
+  bool combined(batch_op op, const key_type& k,
+                const mapped_type* value) noexcept {
+    detail::flat_combiner<combined_op>* c = combiner.load();
+    if (c == nullptr) {
+      detail::flat_combiner<combined_op>* fresh =
+          new detail::flat_combiner<combined_op>;
+      if (combiner.compare_exchange_strong(c, fresh)) {
+        c = fresh;
+      } else {
+        delete fresh;
+      }
+    }
+    combined_op e{op, &k, value, false};
+    c->execute(e, mtx, [this](combined_op& o) {
+      o.result = apply_op(o.op, *o.key, o.value);
+    });
+    return e.result;
+  }
+  // Applies one operation under the write lock, see apply_batch.
+  bool apply_op(batch_op op, const key_type& k,
+                const mapped_type* value) noexcept {
+    iterator it = this->std::map<Key, T, Compare, Alloc>::lower_bound(k);
+    bool found = it != this->std::map<Key, T, Compare, Alloc>::end() &&
+                 !this->key_comp()(k, it->first);
+    if (op == batch_op::erase) {
+      if (found) {
+        publish(change_op::erase, it);
+        this->std::map<Key, T, Compare, Alloc>::erase(it);
+      }
+      return found;
+    }
+    if (!found) {
+      it = this->std::map<Key, T, Compare, Alloc>::emplace_hint(it, k, *value);
+      publish(change_op::insert, it);
+      return true;
+    }
+    if (op == batch_op::assign) {
+      it->second = *value;
+      publish(change_op::assign, it);
+    }
+    return false;
+  }
+
+ public:
+  /**
+   * @brief subscribe, follow the changes of the map from now on
+   *
+   * The first call creates the change feed, a ring of the last capacity
+   * changes; from then on every insert, assignment, erase and clear made
+   * through the map's methods appends an event under the write lock.
+   * Maps nobody subscribed to only test a null pointer per write. Values
+   * changed through references or iterators (operator[], at, find,
+   * call_each) are not seen; feed them through upsert or compute instead.
+   *
+   * To mirror the map: subscribe, copy it with a full scan, then apply the
+   * polled events in order, insert and assign as upsert. On overrun(),
+   * restart() and scan again.
+   *
+   * @param capacity events kept for slow subscribers, fixed by the first
+   * call
+   * @return subscription subscription starting at the newest change
+   */
+  subscription subscribe(size_type capacity = 4096) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    if (!feed) {
+      feed = std::make_shared<detail::change_ring<Key, T>>(capacity);
+    }
+    return subscription(feed);
+  }
+  /**
+   * @brief save_snapshot, write all elements to path in one consistent pass
+   * under the read lock
+   *
+   * The file is a header plus fixed-size records in key order, encoded by
+   * snapshot_traits (trivially copyable types by default). It is written to
+   * a unique temporary file next to path first, synced to disk and renamed,
+   * so path always holds a complete snapshot, also after a crash. The sync
+   * runs after the read lock is released.
+   *
+   * @param path path
+   * @return true written and durable
+   * @return false I/O error, path unchanged; or only the sync of the
+   * directory failed, so path holds the new snapshot but it may not
+   * survive a crash
+   */
+  bool save_snapshot(const std::string& path) const noexcept {
+    using key_traits = snapshot_traits<key_type>;
+    using value_traits = snapshot_traits<mapped_type>;
+    detail::snapshot_writer writer(path, key_traits::SIZE, value_traits::SIZE);
+    {
+      // only the copy needs the lock, not the sync to disk
+      base::ReadLockGuard<RWLock> rlg{mtx};
+      const map& self = *this;
+      writer.start(self.size());
+      for (const value_type& v : self) {
+        char* record = writer.next();
+        key_traits::write(v.first, record);
+        value_traits::write(v.second, record + key_traits::SIZE);
+      }
+    }
+    return writer.commit();
+  }
+  /**
+   * @brief load_snapshot, replace the content with a snapshot written by
+   * save_snapshot
+   *
+   * The file is mapped with mmap and the new tree is built outside the lock
+   * by appending the sorted records with end() as hint, which takes linear
+   * time; the write lock is only held to swap it in.
+   *
+   * @param path path
+   * @return true loaded
+   * @return false missing, truncated or written for other types; the
+   * content is left untouched
+   */
+  bool load_snapshot(const std::string& path) noexcept {
+    using key_traits = snapshot_traits<key_type>;
+    using value_traits = snapshot_traits<mapped_type>;
+    detail::snapshot_reader reader(path, key_traits::SIZE, value_traits::SIZE);
+    if (!reader.valid()) {
+      return false;
+    }
+    map next(this->key_comp(), this->get_allocator());
+    const char* record = reader.records();
+    for (uint64_t i = 0; i < reader.count();
+         i++, record += key_traits::SIZE + value_traits::SIZE) {
+      next.emplace_hint(next.end(), key_traits::read(record),
+                        value_traits::read(record + key_traits::SIZE));
+    }
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    this->std::map<Key, T, Compare, Alloc>::swap(next);
+    publish_reset();
+    return true;
+  }
+  /**
+   * @brief cursor, resumable range scan that copies elements out in chunks
+   *
+   * Every next() takes the read lock for one chunk only and resumes after
+   * the last key it returned, so a long scan never blocks writers for more
+   * than one chunk. Each chunk is consistent on its own; across chunks keys
+   * keep increasing, and elements inserted or erased ahead of the cursor
+   * meanwhile are seen or skipped accordingly. The container has to outlive
+   * the cursor.
+   */
+  class cursor {
+   public:
+    /**
+     * @brief next, copy up to n elements in key order to out
+     *
+     * @tparam OutputIt output iterator accepting value_type
+     * @param n chunk size
+     * @param out out
+     * @return size_type number of elements copied, 0 once the range is done
+     */
+    template <class OutputIt>
+    size_type next(size_type n, OutputIt out) noexcept {
+      if (state_ == DONE || n == 0) {
+        return 0;
+      }
+      base::ReadLockGuard<RWLock> rlg{owner_->mtx};
+      const map& c = *owner_;
+      key_compare comp = c.key_comp();
+      const_iterator it = state_ == BEGIN   ? c.begin()
+                          : state_ == FROM ? c.lower_bound(pos_)
+                                           : c.upper_bound(pos_);
+      const_iterator end = c.end();
+      size_type copied = 0;
+      for (; copied < n && it != end; ++it, ++copied) {
+        if (bounded_ && !comp(it->first, last_)) {
+          break;
+        }
+        *out = *it;
+        ++out;
+      }
+      if (copied > 0) {
+        const_iterator back = it;
+        --back;
+        pos_ = back->first;
+        state_ = AFTER;
+      }
+      if (copied < n) {
+        state_ = DONE;
+      }
+      return copied;
+    }
+    /**
+     * @brief done
+     *
+     * @return true the whole range has been returned
+     * @return false false
+     */
+    bool done() const noexcept { return state_ == DONE; }
+
+   private:
+    friend class tsmap;
+    // BEGIN: start at begin(), FROM: at lower_bound(pos_),
+    // AFTER: at upper_bound(pos_)
+    enum state { BEGIN, FROM, AFTER, DONE };
+    cursor(const tsmap* owner, state s, const key_type& pos,
+           const key_type& last, bool bounded) noexcept
+        : owner_(owner), state_(s), pos_(pos), last_(last),
+          bounded_(bounded) {}
+    const tsmap* owner_;
+    state state_;
+    key_type pos_;
+    key_type last_;
+    bool bounded_;
+  };
+  /**
+   * @brief scan, cursor over all elements; needs a default-constructible
+   * key_type
+   *
+   * @return cursor cursor
+   */
+  cursor scan() const noexcept {
+    return cursor(this, cursor::BEGIN, key_type(), key_type(), false);
+  }
+  /**
+   * @brief scan, cursor over the elements with first <= key < last
+   *
+   * @param first first
+   * @param last last
+   * @return cursor cursor
+   */
+  cursor scan(const key_type& first, const key_type& last) const noexcept {
+    return cursor(this, cursor::FROM, first, last, true);
+  }
+#if defined(__cpp_impl_coroutine)
+  /**
+   * @brief async_find, needs base::CoRWLock as RWLock
+   *
+   * Suspends the calling coroutine instead of blocking the thread while
+   * the lock is busy: auto it = co_await map.async_find(k);
+   *
+   * @param k k
+   * @param executor resumes the coroutine, empty for the lock's default
+   * @return awaitable yielding the iterator
+   */
+  template <class Lock = RWLock>
+  auto async_find(const key_type& k,
+                  typename Lock::Executor executor = nullptr) noexcept {
+    return base::CoLocked(mtx.Read(std::move(executor)), [this, k]() {
+      return this->std::map<Key, T, Compare, Alloc>::find(k);
+    });
+  }
+  /**
+   * @brief async_insert, needs base::CoRWLock as RWLock
+   *
+   * @param val val
+   * @param executor resumes the coroutine, empty for the lock's default
+   * @return awaitable yielding std::pair<iterator, bool>
+   */
+  template <class Lock = RWLock>
+  auto async_insert(const value_type& val,
+                    typename Lock::Executor executor = nullptr) noexcept {
+    return base::CoLocked(mtx.Write(std::move(executor)), [this, val]() {
+      return insert_locked(val);
+    });
+  }
+#endif
+#if defined(TSCONTAINER_LOCK_STATS)
+  /**
+   * @brief stats, snapshot of the lock statistics: acquisitions, wait and
+   * hold histograms, spins and parks; all zero if RWLock records none
+   *
+   * @return base::LockStatsSnapshot snapshot
+   */
+  base::LockStatsSnapshot stats() const noexcept {
+    base::LockStats* s = base::StatsOf(mtx, 0);
+    return s != nullptr ? s->Snapshot() : base::LockStatsSnapshot();
+  }
+#endif
   /**
    * @brief call_each
    *
@@ -488,10 +1412,90 @@ class tsmap : public std::map<Key, T, Compare, Alloc> {
    */
   template <typename P>
   void call_each(P pred) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     std::for_each(this->std::map<Key, T, Compare, Alloc>::begin(),
                   this->std::map<Key, T, Compare, Alloc>::end(), pred);
   }
+  /**
+   * @brief parallel_call_each, call_each with the elements split across
+   * threads; pred runs concurrently for different elements while the read
+   * lock is held once for the whole walk
+   *
+   * @tparam P p
+   * @param pred called as pred(value_type&), must be thread-safe
+   * @param threads number of threads including the calling one, 0 for
+   * std::thread::hardware_concurrency()
+   */
+  template <typename P>
+  void parallel_call_each(P pred, size_type threads = 0) noexcept {
+    thread_executor exec;
+    parallel_call_each(pred, exec, threads);
+  }
+  /**
+   * @brief parallel_call_each, running the helper tasks through exec
+   *
+   * @tparam P p
+   * @tparam Executor callable running task() once on some thread, see
+   * thread_executor
+   * @param pred called as pred(value_type&), must be thread-safe
+   * @param exec executor
+   * @param threads number of tasks including the calling thread
+   */
+  template <typename P, class Executor>
+  void parallel_call_each(P pred, Executor& exec, size_type threads) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    map& self = *this;
+    detail::parallel_for_each(self.begin(), self.end(), self.size(), pred,
+                              exec, threads);
+  }
+  /**
+   * @brief parallel_reduce, fold all elements into one value on several
+   * threads under one read lock
+   *
+   * Each thread folds the chunks it claimed starting from init, so init has
+   * to be the identity of combine, and the elements reach reduce in no
+   * particular order, so reduce and combine have to be associative and
+   * commutative.
+   *
+   * @tparam R result
+   * @tparam Reduce Reduce
+   * @tparam Combine Combine
+   * @param init identity value
+   * @param reduce called as reduce(R, const value_type&) -> R
+   * @param combine called as combine(R, R) -> R
+   * @param threads number of threads including the calling one, 0 for
+   * std::thread::hardware_concurrency()
+   * @return R result
+   */
+  template <class R, class Reduce, class Combine>
+  R parallel_reduce(const R& init, Reduce reduce, Combine combine,
+                    size_type threads = 0) const noexcept {
+    thread_executor exec;
+    return parallel_reduce(init, reduce, combine, exec, threads);
+  }
+  /**
+   * @brief parallel_reduce, running the helper tasks through exec
+   *
+   * @tparam R result
+   * @tparam Reduce Reduce
+   * @tparam Combine Combine
+   * @tparam Executor callable running task() once on some thread, see
+   * thread_executor
+   * @param init identity value
+   * @param reduce called as reduce(R, const value_type&) -> R
+   * @param combine called as combine(R, R) -> R
+   * @param exec executor
+   * @param threads number of tasks including the calling thread
+   * @return R result
+   */
+  template <class R, class Reduce, class Combine, class Executor>
+  R parallel_reduce(const R& init, Reduce reduce, Combine combine,
+                    Executor& exec, size_type threads) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    const map& self = *this;
+    return detail::parallel_reduce(self.begin(), self.end(), self.size(), init,
+                                   reduce, combine, exec, threads);
+  }
 };
 }  // namespace tscontainer
 #endif  // __CONCURRENTMAP_H__
@@ -0,0 +1,166 @@
+#ifndef __TSPARALLEL_H__
+#define __TSPARALLEL_H__
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "lock_wait.h"
+namespace tscontainer {
+/**
+ * @brief thread_executor, default executor of the parallel_* methods: every
+ * task gets its own std::thread, joined when the executor is destroyed
+ *
+ * Any callable that runs task() exactly once, on some thread, can be used
+ * instead, e.g. a submit function of an existing worker pool. The call may
+ * return before the task has run.
+ */
+class thread_executor {
+ public:
+  thread_executor() = default;
+  thread_executor(const thread_executor&) = delete;
+  thread_executor& operator=(const thread_executor&) = delete;
+  ~thread_executor() {
+    for (std::thread& t : threads_) {
+      t.join();
+    }
+  }
+  template <class Task>
+  void operator()(Task task) {
+    threads_.emplace_back(std::move(task));
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+};
+
+namespace detail {
+/**
+ * @brief chunk_source, hands out consecutive chunks of [first, last) to
+ * workers; claiming a chunk walks it under a short mutex, so the walk over
+ * a node-based tree overlaps with the work on earlier chunks and workers
+ * stay balanced however uneven the per-element cost is
+ *
+ * @tparam It forward iterator
+ */
+template <class It>
+class chunk_source {
+ public:
+  chunk_source(It first, It last, std::size_t chunk) noexcept
+      : next_(first), last_(last), chunk_(chunk) {}
+  bool take(It& first, It& last) noexcept {
+    std::lock_guard<std::mutex> lg{mtx_};
+    if (next_ == last_) {
+      return false;
+    }
+    first = next_;
+    for (std::size_t i = 0; i < chunk_ && next_ != last_; i++) {
+      ++next_;
+    }
+    last = next_;
+    return true;
+  }
+
+ private:
+  std::mutex mtx_;
+  It next_;
+  It last_;
+  std::size_t chunk_;
+};
+
+// Worker count and chunk size for n elements: about 16 chunks per worker,
+// at least MIN_CHUNK elements each.
+inline std::size_t parallel_workers(std::size_t n, std::size_t threads,
+                                    std::size_t& chunk) noexcept {
+  const std::size_t MIN_CHUNK = 256;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  chunk = std::max(MIN_CHUNK, n / (threads * 16));
+  return std::max<std::size_t>(1, std::min(threads, (n + chunk - 1) / chunk));
+}
+
+/**
+ * @brief run_workers, runs body(w) for w in [0, workers): worker 0 on the
+ * calling thread, the others through exec; returns once all are done
+ *
+ */
+template <class Body, class Executor>
+void run_workers(std::size_t workers, Body& body, Executor& exec) {
+  std::atomic<int32_t> left{static_cast<int32_t>(workers - 1)};
+  for (std::size_t w = 1; w < workers; w++) {
+    exec([&left, &body, w]() {
+      body(w);
+      if (left.fetch_sub(1) == 1) {
+        // may run after the waiter returned; a stray futex wake is harmless
+        base::FutexWakeAll(&left);
+      }
+    });
+  }
+  body(0);
+  for (int32_t n = left.load(); n != 0; n = left.load()) {
+    base::FutexWait(&left, n);
+  }
+}
+
+/**
+ * @brief parallel_for_each, std::for_each over [first, last) of n elements
+ * on up to threads workers
+ *
+ */
+template <class It, class P, class Executor>
+void parallel_for_each(It first, It last, std::size_t n, P& pred,
+                       Executor& exec, std::size_t threads) {
+  std::size_t chunk = 0;
+  std::size_t workers = parallel_workers(n, threads, chunk);
+  if (workers == 1) {
+    std::for_each(first, last, pred);
+    return;
+  }
+  chunk_source<It> source(first, last, chunk);
+  auto body = [&source, &pred](std::size_t) {
+    It begin, end;
+    while (source.take(begin, end)) {
+      std::for_each(begin, end, pred);
+    }
+  };
+  run_workers(workers, body, exec);
+}
+
+/**
+ * @brief parallel_reduce, folds [first, last) of n elements into one value
+ * on up to threads workers: each worker folds the chunks it claimed with
+ * reduce(R, element) starting from init, and the partial results are then
+ * merged with combine(R, R) in worker order
+ *
+ */
+template <class R, class It, class Reduce, class Combine, class Executor>
+R parallel_reduce(It first, It last, std::size_t n, const R& init,
+                  Reduce& reduce, Combine& combine, Executor& exec,
+                  std::size_t threads) {
+  std::size_t chunk = 0;
+  std::size_t workers = parallel_workers(n, threads, chunk);
+  std::vector<R> partials(workers, init);
+  chunk_source<It> source(first, last, chunk);
+  auto body = [&](std::size_t w) {
+    It begin, end;
+    R& acc = partials[w];
+    while (source.take(begin, end)) {
+      for (; begin != end; ++begin) {
+        acc = reduce(std::move(acc), *begin);
+      }
+    }
+  };
+  run_workers(workers, body, exec);
+  R result = std::move(partials[0]);
+  for (std::size_t w = 1; w < workers; w++) {
+    result = combine(std::move(result), std::move(partials[w]));
+  }
+  return result;
+}
+}  // namespace detail
+}  // namespace tscontainer
+#endif  // __TSPARALLEL_H__
@@ -0,0 +1,246 @@
+#ifndef __TSPOOL_H__
+#define __TSPOOL_H__
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+namespace tscontainer {
+namespace detail {
+/**
+ * @brief node_pool, fixed-size blocks carved from slabs, shared by every
+ * pool_allocator whose value type has the same size and alignment
+ *
+ * Each thread allocates from and frees into its own free list without any
+ * lock. A thread that frees more than 2 * BATCH blocks hands BATCH of them
+ * back to the shared pool in one go, and an empty thread list takes a whole
+ * batch (or a fresh slab) from there, so the shared mutex is taken once per
+ * BATCH operations at most. A fresh slab is handed out in address order, so
+ * nodes allocated together sit next to each other. Slabs are kept for the
+ * lifetime of the process.
+ *
+ * @tparam Size size of a block
+ * @tparam Align alignment of a block
+ */
+template <std::size_t Size, std::size_t Align>
+class node_pool {
+ public:
+  // blocks moved between a thread and the shared pool at once
+  static const std::size_t BATCH = 64;
+  // bytes of one slab
+  static const std::size_t SLAB_BYTES = 64 * 1024;
+
+  /**
+   * @brief allocate one block
+   *
+   * @return void* block
+   */
+  static void* allocate() {
+    if (gone()) {
+      return instance().pop_one();
+    }
+    cache& c = local();
+    if (c.head == nullptr) {
+      c.head = instance().pop_batch(c.num);
+    }
+    free_block* b = c.head;
+    c.head = b->next;
+    c.num--;
+    return b;
+  }
+  /**
+   * @brief deallocate one block, possibly allocated by another thread
+   *
+   * @param p block
+   */
+  static void deallocate(void* p) noexcept {
+    free_block* b = static_cast<free_block*>(p);
+    if (gone()) {
+      b->next = nullptr;
+      instance().push_batch(b, 1);
+      return;
+    }
+    cache& c = local();
+    b->next = c.head;
+    c.head = b;
+    if (++c.num >= 2 * BATCH) {
+      c.release(BATCH);
+    }
+  }
+
+ private:
+  struct free_block {
+    free_block* next;
+    // batch heads only: the next batch of the shared pool and the length
+    free_block* next_batch;
+    std::size_t num;
+  };
+  static const std::size_t BLOCK_ALIGN =
+      Align > alignof(free_block) ? Align : alignof(free_block);
+  static const std::size_t BLOCK =
+      ((Size > sizeof(free_block) ? Size : sizeof(free_block)) + BLOCK_ALIGN -
+       1) / BLOCK_ALIGN * BLOCK_ALIGN;
+  static_assert(BLOCK_ALIGN <= alignof(std::max_align_t),
+                "over-aligned blocks are not pooled");
+  static_assert(SLAB_BYTES >= 2 * BLOCK, "block too large for a slab");
+
+  // Per-thread free list; flushed to the shared pool when the thread ends.
+  struct cache {
+    free_block* head = nullptr;
+    std::size_t num = 0;
+    ~cache() {
+      if (head != nullptr) {
+        instance().push_batch(head, num);
+      }
+      gone() = true;
+    }
+    void release(std::size_t n) noexcept {
+      free_block* first = head;
+      free_block* last = head;
+      for (std::size_t i = 1; i < n; i++) {
+        last = last->next;
+      }
+      head = last->next;
+      num -= n;
+      last->next = nullptr;
+      instance().push_batch(first, n);
+    }
+  };
+
+  std::mutex mtx_;
+  free_block* batches_ = nullptr;
+  // slabs, linked through their first block
+  void* slabs_ = nullptr;
+
+  // Never destroyed, so containers with static storage can still free
+  // their nodes during exit.
+  static node_pool& instance() noexcept {
+    static node_pool* pool = new node_pool;
+    return *pool;
+  }
+  static cache& local() noexcept {
+    static thread_local cache c;
+    return c;
+  }
+  // Set once the thread's cache is destroyed; blocks freed afterwards, e.g.
+  // by static containers, go to the shared pool directly.
+  static bool& gone() noexcept {
+    static thread_local bool g = false;
+    return g;
+  }
+
+  void push_batch(free_block* head, std::size_t num) noexcept {
+    head->num = num;
+    std::lock_guard<std::mutex> lg{mtx_};
+    head->next_batch = batches_;
+    batches_ = head;
+  }
+  // Takes a batch, or a fresh slab if the shared pool is empty.
+  free_block* pop_batch(std::size_t& num) {
+    {
+      std::lock_guard<std::mutex> lg{mtx_};
+      free_block* head = batches_;
+      if (head != nullptr) {
+        batches_ = head->next_batch;
+        num = head->num;
+        return head;
+      }
+    }
+    return new_slab(num);
+  }
+  void* pop_one() {
+    std::size_t num = 0;
+    free_block* head = pop_batch(num);
+    if (head->next != nullptr) {
+      push_batch(head->next, num - 1);
+    }
+    return head;
+  }
+  free_block* new_slab(std::size_t& num) {
+    char* slab = static_cast<char*>(::operator new(SLAB_BYTES));
+    {
+      std::lock_guard<std::mutex> lg{mtx_};
+      *reinterpret_cast<void**>(slab) = slabs_;
+      slabs_ = slab;
+    }
+    // the first block holds the slab link
+    num = SLAB_BYTES / BLOCK - 1;
+    free_block* head = nullptr;
+    for (std::size_t i = num; i > 0; i--) {
+      free_block* b = reinterpret_cast<free_block*>(slab + i * BLOCK);
+      b->next = head;
+      head = b;
+    }
+    return head;
+  }
+};
+}  // namespace detail
+
+/**
+ * @brief pool_allocator, stateless allocator handing out single nodes from
+ * a detail::node_pool, for high-churn tsmap / tsset
+ *
+ * std::map and std::set allocate one node at a time, each insert under the
+ * write lock. With this allocator that is a pop from a thread-local free
+ * list instead of a call into malloc. Requests for more than one element
+ * or over-aligned types go to std::allocator. All instances compare equal,
+ * so nodes may be freed by any thread and any copy.
+ *
+ * @tparam T value type
+ */
+template <class T>
+class pool_allocator {
+ public:
+  // value_type
+  using value_type = T;
+  template <class U>
+  struct rebind {
+    using other = pool_allocator<U>;
+  };
+
+  pool_allocator() noexcept = default;
+  template <class U>
+  pool_allocator(const pool_allocator<U>&) noexcept {}
+
+  /**
+   * @brief allocate
+   *
+   * @param n number of elements
+   * @return T* storage
+   */
+  T* allocate(std::size_t n) {
+    if (n != 1 || alignof(T) > alignof(std::max_align_t)) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T*>(pool::allocate());
+  }
+  /**
+   * @brief deallocate
+   *
+   * @param p storage
+   * @param n number of elements
+   */
+  void deallocate(T* p, std::size_t n) noexcept {
+    if (n != 1 || alignof(T) > alignof(std::max_align_t)) {
+      std::allocator<T>().deallocate(p, n);
+      return;
+    }
+    pool::deallocate(p);
+  }
+
+ private:
+  using pool = detail::node_pool<sizeof(T),
+                                 (alignof(T) > alignof(std::max_align_t)
+                                      ? alignof(std::max_align_t)
+                                      : alignof(T))>;
+};
+
+template <class T, class U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+  return true;
+}
+template <class T, class U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) noexcept {
+  return false;
+}
+}  // namespace tscontainer
+#endif  // __TSPOOL_H__
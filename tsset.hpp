@@ -2,12 +2,20 @@
 #define __TSSET_H__
 #include <algorithm>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <string>
 #include <utility>
-#include "atomic_rw_lock.hpp"
-#include "rw_lock_guard.hpp"
+#include <vector>
+#include "atomic_rw_lock.h"
+#include "co_rw_lock.h"
+#include "rw_lock_guard.h"
+#include "tscommon.hpp"
+#include "tsfeed.hpp"
+#include "tsparallel.hpp"
+#include "tssnapshot.hpp"
 namespace tscontainer {
 /**
  * @brief tsset
@@ -15,11 +23,15 @@ namespace tscontainer {
  * @tparam Key Key
  * @tparam Compare Compare
  * @tparam Alloc Alloc
+ * @tparam RWLock lock policy, any type usable with base::ReadLockGuard and
+ * base::WriteLockGuard (e.g. base::NullRWLock, base::MutexRWLock<>,
+ * base::SharedMutexRWLock<>)
  */
 template <typename Key, typename Compare = std::less<Key>,
-          typename Alloc = std::allocator<Key>>
-class tsset : public std::set<Key> {
- private:
+          typename Alloc = std::allocator<Key>,
+          typename RWLock = base::AtomicRWLock>
+class tsset : public std::set<Key, Compare, Alloc> {
+ public:
   // iterator
   using iterator = typename std::set<Key, Compare, Alloc>::iterator;
   // const_iterator
@@ -36,8 +48,113 @@ class tsset : public std::set<Key> {
   using allocator_type = typename std::set<Key, Compare, Alloc>::allocator_type;
   // set
   using set = typename std::set<Key, Compare, Alloc>;
+  // change
+  using change = change_event<Key, void>;
+  // subscription
+  using subscription = change_subscription<Key, void>;
+
+ private:
   // mtx
-  mutable base::AtomicRWLock mtx;
+  mutable RWLock mtx;
+  // change feed, created by the first subscribe(); guarded by mtx
+  std::shared_ptr<detail::change_ring<Key, void>> feed;
+
+  // Record a change for the subscribers; called under the write lock.
+  void publish(change_op op, const_iterator it) noexcept {
+    if (feed) {
+      feed->publish(op, &*it, nullptr);
+    }
+  }
+  void publish(change_op op) noexcept {
+    if (feed) {
+      feed->publish(op, nullptr, nullptr);
+    }
+  }
+  // The content was replaced wholesale; subscribers have to resync.
+  void publish_reset() noexcept {
+    if (feed) {
+      feed->reset();
+    }
+  }
+  // Insert and publish; called under the write lock, by insert and
+  // async_insert alike.
+  std::pair<iterator, bool> insert_locked(const value_type& val) noexcept {
+    std::pair<iterator, bool> r =
+        this->std::set<Key, Compare, Alloc>::insert(val);
+    if (r.second) {
+      publish(change_op::insert, r.first);
+    }
+    return r;
+  }
+
+  /**
+   * @brief sweep_keys, resolve keys to their lower_bound; f(i, it, hit) is
+   * called once for each keys[i]
+   *
+   * Keys are sorted in blocks of SWEEP_BLOCK indexes on the stack. Each key
+   * first steps forward from the previous one, which is cheap for nearby
+   * keys. Keys farther than SWEEP_STEPS elements away are set aside and
+   * descend the tree DESCENT_GROUP at a time with prefetching, see
+   * detail::group_lower_bound, so f is not called in key order.
+   */
+  template <class Self, class F>
+  static void sweep_keys(Self& self, const key_type* keys, size_type n,
+                         F f) noexcept {
+    const size_type SWEEP_BLOCK = 64;
+    const size_type SWEEP_STEPS = 4;
+    key_compare comp = self.key_comp();
+    auto key_of = [](const value_type& v) -> const key_type& { return v; };
+    auto end = self.end();
+    using iter = decltype(end);
+    size_type order[SWEEP_BLOCK];
+    // far keys waiting for a group descent
+    size_type far[detail::DESCENT_GROUP];
+    const key_type* far_keys[detail::DESCENT_GROUP];
+    iter far_its[detail::DESCENT_GROUP];
+    size_type far_num = 0;
+    auto descend = [&]() {
+      detail::group_lower_bound(self, far_keys, far_num, key_of, comp,
+                                far_its);
+      for (size_type g = 0; g < far_num; g++) {
+        iter it = far_its[g];
+        f(far[g], it, it != end && !comp(*far_keys[g], *it));
+      }
+      // the lower_bound of the largest key, a valid hint for the next ones
+      iter last = far_its[far_num - 1];
+      far_num = 0;
+      return last;
+    };
+    for (size_type first = 0; first < n; first += SWEEP_BLOCK) {
+      size_type m = std::min(SWEEP_BLOCK, n - first);
+      for (size_type j = 0; j < m; j++) {
+        order[j] = first + j;
+      }
+      std::sort(order, order + m, [keys, &comp](size_type a, size_type b) {
+        return comp(keys[a], keys[b]);
+      });
+      iter hint = self.begin();
+      for (size_type j = 0; j < m; j++) {
+        const key_type& k = keys[order[j]];
+        for (size_type step = 0;
+             step < SWEEP_STEPS && hint != end && comp(*hint, k);
+             step++) {
+          ++hint;
+        }
+        if (hint != end && comp(*hint, k)) {
+          far[far_num] = order[j];
+          far_keys[far_num] = &k;
+          if (++far_num == detail::DESCENT_GROUP) {
+            hint = descend();
+          }
+          continue;
+        }
+        f(order[j], hint, hint != end && !comp(k, *hint));
+      }
+      if (far_num != 0) {
+        descend();
+      }
+    }
+  }
 
  public:
   /**
@@ -77,58 +194,63 @@ class tsset : public std::set<Key> {
    * @brief operator=
    *
    * @param x x
-   * @return tsset<Key, Compare, Alloc>& tsset
+   * @return tsset<Key, Compare, Alloc, RWLock>& tsset
    */
-  tsset<Key, Compare, Alloc>& operator=(const set& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsset<Key, Compare, Alloc, RWLock>& operator=(const set& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::set<Key, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsset<Key, Compare, Alloc>& tsset
+   * @return tsset<Key, Compare, Alloc, RWLock>& tsset
    */
-  tsset<Key, Compare, Alloc>& operator=(
-      const tsset<Key, Compare, Alloc>& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsset<Key, Compare, Alloc, RWLock>& operator=(
+      const tsset<Key, Compare, Alloc, RWLock>& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::set<Key, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsset<Key, Compare, Alloc>& tsset
+   * @return tsset<Key, Compare, Alloc, RWLock>& tsset
    */
-  tsset<Key, Compare, Alloc>& operator=(set&& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsset<Key, Compare, Alloc, RWLock>& operator=(set&& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::set<Key, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param x x
-   * @return tsset<Key, Compare, Alloc>& tsset
+   * @return tsset<Key, Compare, Alloc, RWLock>& tsset
    */
-  tsset<Key, Compare, Alloc>& operator=(
-      tsset<Key, Compare, Alloc>&& x) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+  tsset<Key, Compare, Alloc, RWLock>& operator=(
+      tsset<Key, Compare, Alloc, RWLock>&& x) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::set<Key, Compare, Alloc>::operator=(x);
+    publish_reset();
     return *this;
   }
   /**
    * @brief operator=
    *
    * @param il il
-   * @return tsset<Key, Compare, Alloc>& tsset
+   * @return tsset<Key, Compare, Alloc, RWLock>& tsset
    */
-  tsset<Key, Compare, Alloc>& operator=(
+  tsset<Key, Compare, Alloc, RWLock>& operator=(
       std::initializer_list<value_type> il) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::set<Key, Compare, Alloc>::operator=(il);
+    publish_reset();
     return *this;
   }
   /**
@@ -138,7 +260,7 @@ class tsset : public std::set<Key> {
    * @return false false
    */
   bool empty() const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::set<Key, Compare, Alloc>::empty();
   }
   /**
@@ -147,7 +269,7 @@ class tsset : public std::set<Key> {
    * @return size_type size_type
    */
   size_type size() const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::set<Key, Compare, Alloc>::size();
   }
   /**
@@ -157,8 +279,8 @@ class tsset : public std::set<Key> {
    * @return std::pair<iterator, bool> std::pair
    */
   std::pair<iterator, bool> insert(const value_type& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::insert(val);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    return insert_locked(val);
   }
   /**
    * @brief insert
@@ -167,8 +289,13 @@ class tsset : public std::set<Key> {
    * @return std::pair<iterator, bool> std::pair
    */
   std::pair<iterator, bool> insert(value_type&& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::insert(std::move(val));
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    std::pair<iterator, bool> r =
+        this->std::set<Key, Compare, Alloc>::insert(std::move(val));
+    if (r.second) {
+      publish(change_op::insert, r.first);
+    }
+    return r;
   }
   /**
    * @brief insert
@@ -178,8 +305,13 @@ class tsset : public std::set<Key> {
    * @return iterator iterator
    */
   iterator insert(iterator position, const value_type& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::insert(position, val);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type before = this->std::set<Key, Compare, Alloc>::size();
+    iterator it = this->std::set<Key, Compare, Alloc>::insert(position, val);
+    if (this->std::set<Key, Compare, Alloc>::size() != before) {
+      publish(change_op::insert, it);
+    }
+    return it;
   }
   /**
    * @brief insert
@@ -189,9 +321,14 @@ class tsset : public std::set<Key> {
    * @return iterator iterator
    */
   iterator insert(iterator position, value_type&& val) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::insert(position,
-                                                       std::move(val));
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type before = this->std::set<Key, Compare, Alloc>::size();
+    iterator it = this->std::set<Key, Compare, Alloc>::insert(position,
+                                                            std::move(val));
+    if (this->std::set<Key, Compare, Alloc>::size() != before) {
+      publish(change_op::insert, it);
+    }
+    return it;
   }
   /**
    * @brief insert
@@ -202,8 +339,17 @@ class tsset : public std::set<Key> {
    */
   template <class InputIterator>
   void insert(InputIterator first, InputIterator last) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::insert(first, last);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    if (!feed) {
+      return this->std::set<Key, Compare, Alloc>::insert(first, last);
+    }
+    for (; first != last; ++first) {
+      std::pair<iterator, bool> r =
+          this->std::set<Key, Compare, Alloc>::insert(*first);
+      if (r.second) {
+        publish(change_op::insert, r.first);
+      }
+    }
   }
   /**
    * @brief erase
@@ -212,7 +358,8 @@ class tsset : public std::set<Key> {
    * @return iterator iterator
    */
   iterator erase(const_iterator position) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    publish(change_op::erase, position);
     return this->std::set<Key, Compare, Alloc>::erase(position);
   }
   /**
@@ -222,8 +369,15 @@ class tsset : public std::set<Key> {
    * @return size_type size_type
    */
   size_type erase(const key_type& k) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::erase(k);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator it = this->std::set<Key, Compare, Alloc>::find(k);
+    if (it == this->std::set<Key, Compare, Alloc>::end()) {
+      return 0;
+    }
+    // before the erase, k may refer to the erased key
+    publish(change_op::erase, it);
+    this->std::set<Key, Compare, Alloc>::erase(it);
+    return 1;
   }
   /**
    * @brief erase
@@ -233,7 +387,12 @@ class tsset : public std::set<Key> {
    * @return iterator iterator
    */
   iterator erase(const_iterator first, const_iterator last) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    if (feed) {
+      for (const_iterator it = first; it != last; ++it) {
+        publish(change_op::erase, it);
+      }
+    }
     return this->std::set<Key, Compare, Alloc>::erase(first, last);
   }
   /**
@@ -241,8 +400,9 @@ class tsset : public std::set<Key> {
    *
    */
   void clear() noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
+    base::WriteLockGuard<RWLock> wlg{mtx};
     this->std::set<Key, Compare, Alloc>::clear();
+    publish(change_op::clear);
   }
   /**
    * @brief emplace
@@ -253,8 +413,13 @@ class tsset : public std::set<Key> {
    */
   template <class... Args>
   std::pair<iterator, bool> emplace(Args&&... args) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::emplace(args...);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    std::pair<iterator, bool> r =
+        this->std::set<Key, Compare, Alloc>::emplace(args...);
+    if (r.second) {
+      publish(change_op::insert, r.first);
+    }
+    return r;
   }
   /**
    * @brief emplace_hint
@@ -266,8 +431,14 @@ class tsset : public std::set<Key> {
    */
   template <class... Args>
   iterator emplace_hint(const_iterator position, Args&&... args) noexcept {
-    base::WriteLockGuard<base::AtomicRWLock> wlg{mtx};
-    return this->std::set<Key, Compare, Alloc>::emplace_hint(position, args...);
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    size_type before = this->std::set<Key, Compare, Alloc>::size();
+    iterator it =
+        this->std::set<Key, Compare, Alloc>::emplace_hint(position, args...);
+    if (this->std::set<Key, Compare, Alloc>::size() != before) {
+      publish(change_op::insert, it);
+    }
+    return it;
   }
   /**
    * @brief find
@@ -276,7 +447,7 @@ class tsset : public std::set<Key> {
    * @return iterator iterator
    */
   iterator find(const key_type& k) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::set<Key, Compare, Alloc>::find(k);
   }
   /**
@@ -286,7 +457,7 @@ class tsset : public std::set<Key> {
    * @return const_iterator const_iterator
    */
   const_iterator find(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::set<Key, Compare, Alloc>::find(k);
   }
   /**
@@ -296,9 +467,405 @@ class tsset : public std::set<Key> {
    * @return size_type size_type
    */
   size_type count(const key_type& k) const noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     return this->std::set<Key, Compare, Alloc>::count(k);
   }
+  /**
+   * @brief try_find, does not wait for the lock
+   *
+   * @param k k
+   * @param it set to the element found or end(), untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_find(const key_type& k, iterator& it) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx, std::try_to_lock};
+    if (!rlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    it = this->std::set<Key, Compare, Alloc>::find(k);
+    return try_status::done;
+  }
+  /**
+   * @brief try_find, does not wait for the lock
+   *
+   * @param k k
+   * @param it set to the element found or end(), untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_find(const key_type& k, const_iterator& it) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx, std::try_to_lock};
+    if (!rlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    it = this->std::set<Key, Compare, Alloc>::find(k);
+    return try_status::done;
+  }
+  /**
+   * @brief try_insert, does not wait for the lock
+   *
+   * @param val val
+   * @param result result of insert, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_insert(const value_type& val,
+                        std::pair<iterator, bool>& result) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    result = this->std::set<Key, Compare, Alloc>::insert(val);
+    if (result.second) {
+      publish(change_op::insert, result.first);
+    }
+    return try_status::done;
+  }
+  /**
+   * @brief try_erase, does not wait for the lock
+   *
+   * @param k k
+   * @param count number of elements erased, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_erase(const key_type& k, size_type& count) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    iterator it = this->std::set<Key, Compare, Alloc>::find(k);
+    count = it != this->std::set<Key, Compare, Alloc>::end() ? 1 : 0;
+    if (count != 0) {
+      publish(change_op::erase, it);
+      this->std::set<Key, Compare, Alloc>::erase(it);
+    }
+    return try_status::done;
+  }
+  /**
+   * @brief find_many, find all keys under one read lock
+   *
+   * @param keys keys
+   * @param n number of keys
+   * @param out out[i] receives find(keys[i]); like find, the iterators are
+   * not protected once the call has finished
+   * @return size_type number of keys found
+   */
+  size_type find_many(const key_type* keys, size_type n,
+                      const_iterator* out) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type hits = 0;
+    const set& self = *this;
+    const_iterator end = self.end();
+    sweep_keys(self, keys, n, [&](size_type i, const_iterator it, bool hit) {
+      out[i] = hit ? it : end;
+      hits += hit ? 1 : 0;
+    });
+    return hits;
+  }
+  /**
+   * @brief count_many, look up all keys under one read lock
+   *
+   * @param keys keys
+   * @param n number of keys
+   * @param found found[i] is set to whether keys[i] is present
+   * @return size_type number of keys found
+   */
+  size_type count_many(const key_type* keys, size_type n,
+                       bool* found) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    size_type hits = 0;
+    sweep_keys(static_cast<const set&>(*this), keys, n,
+               [&](size_type i, const_iterator, bool hit) {
+                 found[i] = hit;
+                 hits += hit ? 1 : 0;
+               });
+    return hits;
+  }
+  /**
+   * @brief batch_entry, one operation of apply_batch
+   *
+   */
+  struct batch_entry {
+    // assign behaves like insert
+    batch_op op;
+    key_type key;
+  };
+  /**
+   * @brief apply_batch, apply many operations under one write lock
+   *
+   * The operations are sorted by key before the lock is taken (operations
+   * on the same key keep their order) and applied in one pass, each
+   * starting from where the previous one left off, so most of them need
+   * no tree descent.
+   *
+   * @param ops ops
+   * @param n number of operations
+   * @param results results[i] receives the result of ops[i], see batch_op;
+   * may be nullptr
+   * @return size_type number of operations with a true result
+   */
+  size_type apply_batch(const batch_entry* ops, size_type n,
+                        bool* results = nullptr) noexcept {
+    std::vector<size_type> order(n);
+    for (size_type i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    key_compare comp = this->key_comp();
+    std::stable_sort(order.begin(), order.end(),
+                     [ops, &comp](size_type a, size_type b) {
+                       return comp(ops[a].key, ops[b].key);
+                     });
+    size_type done = 0;
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    iterator end = this->std::set<Key, Compare, Alloc>::end();
+    // lower_bound of the previous key, so of every key before the next one
+    iterator hint = this->std::set<Key, Compare, Alloc>::begin();
+    for (size_type i : order) {
+      const batch_entry& e = ops[i];
+      if (hint != end && comp(*hint, e.key)) {
+        ++hint;
+        if (hint != end && comp(*hint, e.key)) {
+          hint = this->std::set<Key, Compare, Alloc>::lower_bound(e.key);
+        }
+      }
+      bool found = hint != end && !comp(e.key, *hint);
+      bool result = false;
+      if (e.op == batch_op::erase) {
+        if (found) {
+          publish(change_op::erase, hint);
+          hint = this->std::set<Key, Compare, Alloc>::erase(hint);
+          result = true;
+        }
+      } else if (!found) {
+        hint = this->std::set<Key, Compare, Alloc>::emplace_hint(hint, e.key);
+        publish(change_op::insert, hint);
+        result = true;
+      }
+      if (results != nullptr) {
+        results[i] = result;
+      }
+      done += result ? 1 : 0;
+    }
+    return done;
+  }
+  /**
+   * @brief subscribe, follow the changes of the set from now on
+   *
+   * The first call creates the change feed, a ring of the last capacity
+   * changes; from then on every insert, erase and clear appends an event
+   * under the write lock. Sets nobody subscribed to only test a null
+   * pointer per write. To mirror the set: subscribe, copy it with a full
+   * scan, then apply the polled events in order. On overrun(), restart()
+   * and scan again.
+   *
+   * @param capacity events kept for slow subscribers, fixed by the first
+   * call
+   * @return subscription subscription starting at the newest change
+   */
+  subscription subscribe(size_type capacity = 4096) noexcept {
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    if (!feed) {
+      feed = std::make_shared<detail::change_ring<Key, void>>(capacity);
+    }
+    return subscription(feed);
+  }
+  /**
+   * @brief save_snapshot, write all elements to path in one consistent pass
+   * under the read lock
+   *
+   * The file is a header plus fixed-size records in key order, encoded by
+   * snapshot_traits (trivially copyable types by default). It is written to
+   * a unique temporary file next to path first, synced to disk and renamed,
+   * so path always holds a complete snapshot, also after a crash. The sync
+   * runs after the read lock is released.
+   *
+   * @param path path
+   * @return true written and durable
+   * @return false I/O error, path unchanged; or only the sync of the
+   * directory failed, so path holds the new snapshot but it may not
+   * survive a crash
+   */
+  bool save_snapshot(const std::string& path) const noexcept {
+    using key_traits = snapshot_traits<key_type>;
+    detail::snapshot_writer writer(path, key_traits::SIZE, 0);
+    {
+      // only the copy needs the lock, not the sync to disk
+      base::ReadLockGuard<RWLock> rlg{mtx};
+      const set& self = *this;
+      writer.start(self.size());
+      for (const value_type& v : self) {
+        char* record = writer.next();
+        key_traits::write(v, record);
+      }
+    }
+    return writer.commit();
+  }
+  /**
+   * @brief load_snapshot, replace the content with a snapshot written by
+   * save_snapshot
+   *
+   * The file is mapped with mmap and the new tree is built outside the lock
+   * by appending the sorted records with end() as hint, which takes linear
+   * time; the write lock is only held to swap it in.
+   *
+   * @param path path
+   * @return true loaded
+   * @return false missing, truncated or written for other types; the
+   * content is left untouched
+   */
+  bool load_snapshot(const std::string& path) noexcept {
+    using key_traits = snapshot_traits<key_type>;
+    detail::snapshot_reader reader(path, key_traits::SIZE, 0);
+    if (!reader.valid()) {
+      return false;
+    }
+    set next(this->key_comp(), this->get_allocator());
+    const char* record = reader.records();
+    for (uint64_t i = 0; i < reader.count();
+         i++, record += key_traits::SIZE) {
+      next.emplace_hint(next.end(), key_traits::read(record));
+    }
+    base::WriteLockGuard<RWLock> wlg{mtx};
+    this->std::set<Key, Compare, Alloc>::swap(next);
+    publish_reset();
+    return true;
+  }
+  /**
+   * @brief cursor, resumable range scan that copies elements out in chunks
+   *
+   * Every next() takes the read lock for one chunk only and resumes after
+   * the last key it returned, so a long scan never blocks writers for more
+   * than one chunk. Each chunk is consistent on its own; across chunks keys
+   * keep increasing, and elements inserted or erased ahead of the cursor
+   * meanwhile are seen or skipped accordingly. The container has to outlive
+   * the cursor.
+   */
+  class cursor {
+   public:
+    /**
+     * @brief next, copy up to n elements in key order to out
+     *
+     * @tparam OutputIt output iterator accepting key_type
+     * @param n chunk size
+     * @param out out
+     * @return size_type number of elements copied, 0 once the range is done
+     */
+    template <class OutputIt>
+    size_type next(size_type n, OutputIt out) noexcept {
+      if (state_ == DONE || n == 0) {
+        return 0;
+      }
+      base::ReadLockGuard<RWLock> rlg{owner_->mtx};
+      const set& c = *owner_;
+      key_compare comp = c.key_comp();
+      const_iterator it = state_ == BEGIN   ? c.begin()
+                          : state_ == FROM ? c.lower_bound(pos_)
+                                           : c.upper_bound(pos_);
+      const_iterator end = c.end();
+      size_type copied = 0;
+      for (; copied < n && it != end; ++it, ++copied) {
+        if (bounded_ && !comp(*it, last_)) {
+          break;
+        }
+        *out = *it;
+        ++out;
+      }
+      if (copied > 0) {
+        const_iterator back = it;
+        --back;
+        pos_ = *back;
+        state_ = AFTER;
+      }
+      if (copied < n) {
+        state_ = DONE;
+      }
+      return copied;
+    }
+    /**
+     * @brief done
+     *
+     * @return true the whole range has been returned
+     * @return false false
+     */
+    bool done() const noexcept { return state_ == DONE; }
+
+   private:
+    friend class tsset;
+    // BEGIN: start at begin(), FROM: at lower_bound(pos_),
+    // AFTER: at upper_bound(pos_)
+    enum state { BEGIN, FROM, AFTER, DONE };
+    cursor(const tsset* owner, state s, const key_type& pos,
+           const key_type& last, bool bounded) noexcept
+        : owner_(owner), state_(s), pos_(pos), last_(last),
+          bounded_(bounded) {}
+    const tsset* owner_;
+    state state_;
+    key_type pos_;
+    key_type last_;
+    bool bounded_;
+  };
+  /**
+   * @brief scan, cursor over all elements; needs a default-constructible
+   * key_type
+   *
+   * @return cursor cursor
+   */
+  cursor scan() const noexcept {
+    return cursor(this, cursor::BEGIN, key_type(), key_type(), false);
+  }
+  /**
+   * @brief scan, cursor over the elements with first <= key < last
+   *
+   * @param first first
+   * @param last last
+   * @return cursor cursor
+   */
+  cursor scan(const key_type& first, const key_type& last) const noexcept {
+    return cursor(this, cursor::FROM, first, last, true);
+  }
+#if defined(__cpp_impl_coroutine)
+  /**
+   * @brief async_find, needs base::CoRWLock as RWLock
+   *
+   * Suspends the calling coroutine instead of blocking the thread while
+   * the lock is busy: auto it = co_await set.async_find(k);
+   *
+   * @param k k
+   * @param executor resumes the coroutine, empty for the lock's default
+   * @return awaitable yielding the iterator
+   */
+  template <class Lock = RWLock>
+  auto async_find(const key_type& k,
+                  typename Lock::Executor executor = nullptr) noexcept {
+    return base::CoLocked(mtx.Read(std::move(executor)), [this, k]() {
+      return this->std::set<Key, Compare, Alloc>::find(k);
+    });
+  }
+  /**
+   * @brief async_insert, needs base::CoRWLock as RWLock
+   *
+   * @param val val
+   * @param executor resumes the coroutine, empty for the lock's default
+   * @return awaitable yielding std::pair<iterator, bool>
+   */
+  template <class Lock = RWLock>
+  auto async_insert(const value_type& val,
+                    typename Lock::Executor executor = nullptr) noexcept {
+    return base::CoLocked(mtx.Write(std::move(executor)), [this, val]() {
+      return insert_locked(val);
+    });
+  }
+#endif
+#if defined(TSCONTAINER_LOCK_STATS)
+  /**
+   * @brief stats, snapshot of the lock statistics: acquisitions, wait and
+   * hold histograms, spins and parks; all zero if RWLock records none
+   *
+   * @return base::LockStatsSnapshot snapshot
+   */
+  base::LockStatsSnapshot stats() const noexcept {
+    base::LockStats* s = base::StatsOf(mtx, 0);
+    return s != nullptr ? s->Snapshot() : base::LockStatsSnapshot();
+  }
+#endif
   /**
    * @brief call_each
    *
@@ -307,10 +874,90 @@ class tsset : public std::set<Key> {
    */
   template <typename P>
   void call_each(P pred) noexcept {
-    base::ReadLockGuard<base::AtomicRWLock> rlg{mtx};
+    base::ReadLockGuard<RWLock> rlg{mtx};
     std::for_each(this->std::set<Key, Compare, Alloc>::begin(),
                   this->std::set<Key, Compare, Alloc>::end(), pred);
   }
+  /**
+   * @brief parallel_call_each, call_each with the elements split across
+   * threads; pred runs concurrently for different elements while the read
+   * lock is held once for the whole walk
+   *
+   * @tparam P p
+   * @param pred called as pred(const value_type&), must be thread-safe
+   * @param threads number of threads including the calling one, 0 for
+   * std::thread::hardware_concurrency()
+   */
+  template <typename P>
+  void parallel_call_each(P pred, size_type threads = 0) noexcept {
+    thread_executor exec;
+    parallel_call_each(pred, exec, threads);
+  }
+  /**
+   * @brief parallel_call_each, running the helper tasks through exec
+   *
+   * @tparam P p
+   * @tparam Executor callable running task() once on some thread, see
+   * thread_executor
+   * @param pred called as pred(const value_type&), must be thread-safe
+   * @param exec executor
+   * @param threads number of tasks including the calling thread
+   */
+  template <typename P, class Executor>
+  void parallel_call_each(P pred, Executor& exec, size_type threads) noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    set& self = *this;
+    detail::parallel_for_each(self.begin(), self.end(), self.size(), pred,
+                              exec, threads);
+  }
+  /**
+   * @brief parallel_reduce, fold all elements into one value on several
+   * threads under one read lock
+   *
+   * Each thread folds the chunks it claimed starting from init, so init has
+   * to be the identity of combine, and the elements reach reduce in no
+   * particular order, so reduce and combine have to be associative and
+   * commutative.
+   *
+   * @tparam R result
+   * @tparam Reduce Reduce
+   * @tparam Combine Combine
+   * @param init identity value
+   * @param reduce called as reduce(R, const value_type&) -> R
+   * @param combine called as combine(R, R) -> R
+   * @param threads number of threads including the calling one, 0 for
+   * std::thread::hardware_concurrency()
+   * @return R result
+   */
+  template <class R, class Reduce, class Combine>
+  R parallel_reduce(const R& init, Reduce reduce, Combine combine,
+                    size_type threads = 0) const noexcept {
+    thread_executor exec;
+    return parallel_reduce(init, reduce, combine, exec, threads);
+  }
+  /**
+   * @brief parallel_reduce, running the helper tasks through exec
+   *
+   * @tparam R result
+   * @tparam Reduce Reduce
+   * @tparam Combine Combine
+   * @tparam Executor callable running task() once on some thread, see
+   * thread_executor
+   * @param init identity value
+   * @param reduce called as reduce(R, const value_type&) -> R
+   * @param combine called as combine(R, R) -> R
+   * @param exec executor
+   * @param threads number of tasks including the calling thread
+   * @return R result
+   */
+  template <class R, class Reduce, class Combine, class Executor>
+  R parallel_reduce(const R& init, Reduce reduce, Combine combine,
+                    Executor& exec, size_type threads) const noexcept {
+    base::ReadLockGuard<RWLock> rlg{mtx};
+    const set& self = *this;
+    return detail::parallel_reduce(self.begin(), self.end(), self.size(), init,
+                                   reduce, combine, exec, threads);
+  }
 };
 }  // namespace tscontainer
 #endif  // __TSSET_H__
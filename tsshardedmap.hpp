@@ -0,0 +1,385 @@
+#ifndef __TSSHARDEDMAP_H__
+#define __TSSHARDEDMAP_H__
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "atomic_rw_lock.h"
+#include "rw_lock_guard.h"
+#include "tscommon.hpp"
+namespace tscontainer {
+/**
+ * @brief tsshardedmap, keys partitioned across ShardNum independent
+ * std::map + lock shards, so writers to different shards do not serialize
+ *
+ * There is no container-wide iterator: returned iterators point into one
+ * shard and, as with tsmap, are not protected once the call has finished.
+ * There is no single end() either, so find() reports a hit in a bool next to
+ * the iterator.
+ *
+ * @tparam Key key
+ * @tparam T t
+ * @tparam ShardNum number of shards
+ * @tparam Partition key to shard functor, taken modulo ShardNum
+ * @tparam Compare compare
+ * @tparam std::allocator<std::pair<const Key, T>> alloc
+ * @tparam RWLock lock policy of every shard
+ */
+template <class Key, class T, std::size_t ShardNum = 16,
+          class Partition = hash_partition<Key>,
+          class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, T>>,
+          class RWLock = base::AtomicRWLock>
+class tsshardedmap {
+  static_assert(ShardNum > 0, "tsshardedmap needs at least one shard");
+
+ public:
+  // map
+  using map = typename std::map<Key, T, Compare, Alloc>;
+  // iterator
+  using iterator = typename map::iterator;
+  // const_iterator
+  using const_iterator = typename map::const_iterator;
+  // key_type
+  using key_type = typename map::key_type;
+  // value_type
+  using value_type = typename map::value_type;
+  // mapped_type
+  using mapped_type = typename map::mapped_type;
+  // size_type
+  using size_type = typename map::size_type;
+
+ private:
+  /**
+   * @brief shard, padded so neighbouring locks do not share a cache line
+   *
+   */
+  struct alignas(base::CACHE_LINE_SIZE) shard {
+    map m;
+    mutable RWLock mtx;
+    // num, m.size() stored under the write lock, read without it
+    std::atomic<size_type> num = {0};
+  };
+  // shards
+  shard shards[ShardNum];
+
+  shard& shard_of(const key_type& k) noexcept {
+    return shards[Partition()(k) % ShardNum];
+  }
+  const shard& shard_of(const key_type& k) const noexcept {
+    return shards[Partition()(k) % ShardNum];
+  }
+  static void update_num(shard& s) noexcept {
+    s.num.store(s.m.size(), std::memory_order_relaxed);
+  }
+
+ public:
+  /**
+   * @brief Construct a new tsshardedmap object
+   *
+   */
+  tsshardedmap() = default;
+
+  tsshardedmap(const tsshardedmap&) = delete;
+  tsshardedmap& operator=(const tsshardedmap&) = delete;
+
+  /**
+   * @brief shard_num
+   *
+   * @return std::size_t number of shards
+   */
+  static constexpr std::size_t shard_num() noexcept { return ShardNum; }
+  /**
+   * @brief empty, without taking any lock
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return size() == 0; }
+  /**
+   * @brief size, sum of the per-shard counters without taking any lock;
+   * shards written meanwhile may be counted before or after the write
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept {
+    size_type total = 0;
+    for (const shard& s : shards) {
+      total += s.num.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+  /**
+   * @brief operator[]
+   *
+   * @param k k
+   * @return mapped_type& mapped_type
+   */
+  mapped_type& operator[](const key_type& k) noexcept {
+    return find_or_emplace(k).first->second;
+  }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return std::pair<iterator, bool> std::pair
+   */
+  std::pair<iterator, bool> insert(const value_type& val) noexcept {
+    shard& s = shard_of(val.first);
+    base::WriteLockGuard<RWLock> wlg{s.mtx};
+    std::pair<iterator, bool> res = s.m.insert(val);
+    update_num(s);
+    return res;
+  }
+  /**
+   * @brief emplace
+   *
+   * @tparam Args Args
+   * @param args arguments to construct the value_type
+   * @return std::pair<iterator, bool> std::pair
+   */
+  template <class... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) noexcept {
+    // the key picks the shard, so the element is built before the lock
+    value_type val(std::forward<Args>(args)...);
+    shard& s = shard_of(val.first);
+    base::WriteLockGuard<RWLock> wlg{s.mtx};
+    std::pair<iterator, bool> res = s.m.insert(std::move(val));
+    update_num(s);
+    return res;
+  }
+  /**
+   * @brief find_or_emplace, see tsmap::find_or_emplace
+   *
+   * @tparam Args Args
+   * @param k k
+   * @param args arguments to construct the mapped value on a miss
+   * @return std::pair<iterator, bool> std::pair, true if inserted
+   */
+  template <class... Args>
+  std::pair<iterator, bool> find_or_emplace(const key_type& k,
+                                            Args&&... args) noexcept {
+    shard& s = shard_of(k);
+    base::UpgradeLockGuard<RWLock> ulg{s.mtx};
+    iterator it = s.m.lower_bound(k);
+    if (it != s.m.end() && !s.m.key_comp()(k, it->first)) {
+      return std::make_pair(it, false);
+    }
+    ulg.Upgrade();
+    it = s.m.emplace_hint(it, std::piecewise_construct,
+                          std::forward_as_tuple(k),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    update_num(s);
+    return std::make_pair(it, true);
+  }
+  /**
+   * @brief find_or_insert
+   *
+   * @param val val
+   * @return std::pair<iterator, bool> std::pair, true if inserted
+   */
+  std::pair<iterator, bool> find_or_insert(const value_type& val) noexcept {
+    return find_or_emplace(val.first, val.second);
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept {
+    shard& s = shard_of(k);
+    base::WriteLockGuard<RWLock> wlg{s.mtx};
+    size_type count = s.m.erase(k);
+    update_num(s);
+    return count;
+  }
+  /**
+   * @brief clear, one shard after the other
+   *
+   */
+  void clear() noexcept {
+    for (shard& s : shards) {
+      base::WriteLockGuard<RWLock> wlg{s.mtx};
+      s.m.clear();
+      update_num(s);
+    }
+  }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    const shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    return s.m.count(k);
+  }
+  /**
+   * @brief find
+   *
+   * @param k k
+   * @return std::pair<iterator, bool> std::pair, true if found; the
+   * iterator points into the shard of k and is only valid if found
+   */
+  std::pair<iterator, bool> find(const key_type& k) noexcept {
+    shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    iterator it = s.m.find(k);
+    return std::make_pair(it, it != s.m.end());
+  }
+  /**
+   * @brief find
+   *
+   * @param k k
+   * @return std::pair<const_iterator, bool> std::pair, true if found; the
+   * iterator points into the shard of k and is only valid if found
+   */
+  std::pair<const_iterator, bool> find(const key_type& k) const noexcept {
+    const shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    const_iterator it = s.m.find(k);
+    return std::make_pair(it, it != s.m.end());
+  }
+  /**
+   * @brief at
+   *
+   * @param k k
+   * @return mapped_type& mapped_type
+   */
+  mapped_type& at(const key_type& k) noexcept {
+    shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    return s.m.at(k);
+  }
+  /**
+   * @brief at
+   *
+   * @param k k
+   * @return const mapped_type& mapped_type
+   */
+  const mapped_type& at(const key_type& k) const noexcept {
+    const shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    return s.m.at(k);
+  }
+#if __cplusplus >= 201703L
+  /**
+   * @brief get, copy the value of k out under the read lock of its shard
+   *
+   * @param k k
+   * @return std::optional<mapped_type> the value, empty if k is not found
+   */
+  std::optional<mapped_type> get(const key_type& k) const noexcept {
+    const shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    auto it = s.m.find(k);
+    if (it == s.m.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+#endif
+  /**
+   * @brief visit, call f on the value of k under the read lock of its shard
+   *
+   * @tparam F F
+   * @param k k
+   * @param f called as f(const mapped_type&); must not touch the map
+   * @return true k found, f called
+   * @return false k not found
+   */
+  template <class F>
+  bool visit(const key_type& k, F f) const noexcept {
+    const shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    auto it = s.m.find(k);
+    if (it == s.m.end()) {
+      return false;
+    }
+    f(it->second);
+    return true;
+  }
+  /**
+   * @brief read_copy, see tsmap::read_copy; get() works for any
+   * mapped_type
+   *
+   * @param k k
+   * @param value receives the value of k if found
+   * @return true k found
+   * @return false k not found, value untouched
+   */
+  bool read_copy(const key_type& k, mapped_type& value) const noexcept {
+    static_assert(std::is_trivially_copyable<mapped_type>::value,
+                  "read_copy needs a trivially copyable mapped_type");
+    const shard& s = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{s.mtx};
+    auto it = s.m.find(k);
+    if (it == s.m.end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+  /**
+   * @brief try_insert, does not wait for the lock of the shard
+   *
+   * @param val val
+   * @param result result of insert, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_insert(const value_type& val,
+                        std::pair<iterator, bool>& result) noexcept {
+    shard& s = shard_of(val.first);
+    base::WriteLockGuard<RWLock> wlg{s.mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    result = s.m.insert(val);
+    update_num(s);
+    return try_status::done;
+  }
+  /**
+   * @brief try_erase, does not wait for the lock of the shard
+   *
+   * @param k k
+   * @param count number of elements erased, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_erase(const key_type& k, size_type& count) noexcept {
+    shard& s = shard_of(k);
+    base::WriteLockGuard<RWLock> wlg{s.mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    count = s.m.erase(k);
+    update_num(s);
+    return try_status::done;
+  }
+  /**
+   * @brief call_each, visits the shards in order, holding the read lock of
+   * one shard at a time
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) noexcept {
+    for (shard& s : shards) {
+      base::ReadLockGuard<RWLock> rlg{s.mtx};
+      std::for_each(s.m.begin(), s.m.end(), pred);
+    }
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSSHARDEDMAP_H__
@@ -0,0 +1,224 @@
+#ifndef __TSSHARDEDSET_H__
+#define __TSSHARDEDSET_H__
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include "atomic_rw_lock.h"
+#include "rw_lock_guard.h"
+#include "tscommon.hpp"
+namespace tscontainer {
+/**
+ * @brief tsshardedset, keys partitioned across ShardNum independent
+ * std::set + lock shards, so writers to different shards do not serialize
+ *
+ * There is no container-wide iterator: returned iterators point into one
+ * shard and, as with tsset, are not protected once the call has finished.
+ * There is no single end() either, so find() reports a hit in a bool next to
+ * the iterator.
+ *
+ * @tparam Key key
+ * @tparam ShardNum number of shards
+ * @tparam Partition key to shard functor, taken modulo ShardNum
+ * @tparam Compare compare
+ * @tparam std::allocator<Key> alloc
+ * @tparam RWLock lock policy of every shard
+ */
+template <class Key, std::size_t ShardNum = 16,
+          class Partition = hash_partition<Key>,
+          class Compare = std::less<Key>, class Alloc = std::allocator<Key>,
+          class RWLock = base::AtomicRWLock>
+class tsshardedset {
+  static_assert(ShardNum > 0, "tsshardedset needs at least one shard");
+
+ public:
+  // set
+  using set = typename std::set<Key, Compare, Alloc>;
+  // iterator
+  using iterator = typename set::iterator;
+  // const_iterator
+  using const_iterator = typename set::const_iterator;
+  // key_type
+  using key_type = typename set::key_type;
+  // value_type
+  using value_type = typename set::value_type;
+  // size_type
+  using size_type = typename set::size_type;
+
+ private:
+  /**
+   * @brief shard, padded so neighbouring locks do not share a cache line
+   *
+   */
+  struct alignas(base::CACHE_LINE_SIZE) shard {
+    set s;
+    mutable RWLock mtx;
+    // num, s.size() stored under the write lock, read without it
+    std::atomic<size_type> num = {0};
+  };
+  // shards
+  shard shards[ShardNum];
+
+  shard& shard_of(const key_type& k) noexcept {
+    return shards[Partition()(k) % ShardNum];
+  }
+  const shard& shard_of(const key_type& k) const noexcept {
+    return shards[Partition()(k) % ShardNum];
+  }
+  static void update_num(shard& sh) noexcept {
+    sh.num.store(sh.s.size(), std::memory_order_relaxed);
+  }
+
+ public:
+  /**
+   * @brief Construct a new tsshardedset object
+   *
+   */
+  tsshardedset() = default;
+
+  tsshardedset(const tsshardedset&) = delete;
+  tsshardedset& operator=(const tsshardedset&) = delete;
+
+  /**
+   * @brief shard_num
+   *
+   * @return std::size_t number of shards
+   */
+  static constexpr std::size_t shard_num() noexcept { return ShardNum; }
+  /**
+   * @brief empty, without taking any lock
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return size() == 0; }
+  /**
+   * @brief size, sum of the per-shard counters without taking any lock;
+   * shards written meanwhile may be counted before or after the write
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept {
+    size_type total = 0;
+    for (const shard& sh : shards) {
+      total += sh.num.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+  /**
+   * @brief insert
+   *
+   * @param val val
+   * @return std::pair<iterator, bool> std::pair
+   */
+  std::pair<iterator, bool> insert(const value_type& val) noexcept {
+    shard& sh = shard_of(val);
+    base::WriteLockGuard<RWLock> wlg{sh.mtx};
+    std::pair<iterator, bool> res = sh.s.insert(val);
+    update_num(sh);
+    return res;
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept {
+    shard& sh = shard_of(k);
+    base::WriteLockGuard<RWLock> wlg{sh.mtx};
+    size_type count = sh.s.erase(k);
+    update_num(sh);
+    return count;
+  }
+  /**
+   * @brief clear, one shard after the other
+   *
+   */
+  void clear() noexcept {
+    for (shard& sh : shards) {
+      base::WriteLockGuard<RWLock> wlg{sh.mtx};
+      sh.s.clear();
+      update_num(sh);
+    }
+  }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    const shard& sh = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{sh.mtx};
+    return sh.s.count(k);
+  }
+  /**
+   * @brief find
+   *
+   * @param k k
+   * @return std::pair<const_iterator, bool> std::pair, true if found; the
+   * iterator points into the shard of k and is only valid if found
+   */
+  std::pair<const_iterator, bool> find(const key_type& k) const noexcept {
+    const shard& sh = shard_of(k);
+    base::ReadLockGuard<RWLock> rlg{sh.mtx};
+    const_iterator it = sh.s.find(k);
+    return std::make_pair(it, it != sh.s.end());
+  }
+  /**
+   * @brief try_insert, does not wait for the lock of the shard
+   *
+   * @param val val
+   * @param result result of insert, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_insert(const value_type& val,
+                        std::pair<iterator, bool>& result) noexcept {
+    shard& sh = shard_of(val);
+    base::WriteLockGuard<RWLock> wlg{sh.mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    result = sh.s.insert(val);
+    update_num(sh);
+    return try_status::done;
+  }
+  /**
+   * @brief try_erase, does not wait for the lock of the shard
+   *
+   * @param k k
+   * @param count number of elements erased, untouched on would_block
+   * @return try_status try_status
+   */
+  try_status try_erase(const key_type& k, size_type& count) noexcept {
+    shard& sh = shard_of(k);
+    base::WriteLockGuard<RWLock> wlg{sh.mtx, std::try_to_lock};
+    if (!wlg.OwnsLock()) {
+      return try_status::would_block;
+    }
+    count = sh.s.erase(k);
+    update_num(sh);
+    return try_status::done;
+  }
+  /**
+   * @brief call_each, visits the shards in order, holding the read lock of
+   * one shard at a time
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) noexcept {
+    for (shard& sh : shards) {
+      base::ReadLockGuard<RWLock> rlg{sh.mtx};
+      std::for_each(sh.s.begin(), sh.s.end(), pred);
+    }
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSSHARDEDSET_H__
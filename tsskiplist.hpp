@@ -0,0 +1,365 @@
+#ifndef __TSSKIPLIST_H__
+#define __TSSKIPLIST_H__
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include "tsepoch.hpp"
+namespace tscontainer {
+namespace detail {
+/**
+ * @brief skip_list, lock-free ordered skip list behind tsskipmap and
+ * tsskipset
+ *
+ * Nodes are linked with CAS on every level. Erasing marks the links of a
+ * node (low pointer bit), top level first; whoever marks level 0 owns the
+ * erase, and any traversal that meets a marked node snips it out. Lookups
+ * and iteration only read, so readers never write shared memory other than
+ * their epoch slot. Unlinked nodes are retired into an epoch_domain and
+ * freed two epochs later.
+ *
+ * An insert links the upper levels after level 0; if the node is erased
+ * meanwhile, whichever of the inserter and the eraser finishes last snips
+ * the node off every level and retires it.
+ *
+ * @tparam Value stored value
+ * @tparam Key key
+ * @tparam KeyOf functor returning the key of a value
+ * @tparam Compare compare
+ * @tparam Alloc allocator of Value, rebound to the node type
+ */
+template <class Value, class Key, class KeyOf, class Compare, class Alloc>
+class skip_list {
+ public:
+  // size_type
+  using size_type = std::size_t;
+  // maximal node height; with p = 1/4 enough for 4^16 elements
+  static const uint32_t MAX_LEVEL = 16;
+
+ private:
+  using link = std::atomic<uintptr_t>;
+  static const uintptr_t MARKED = 1;
+  static const uint32_t INSERTED = 1;
+  static const uint32_t ERASED = 2;
+  // collect retired nodes every RETIRE_BATCH retirements
+  static const uint32_t RETIRE_BATCH = 64;
+
+  struct node {
+    template <class... Args>
+    explicit node(uint32_t lvl, Args&&... args)
+        : value(std::forward<Args>(args)...), level(lvl) {}
+    Value value;
+    node* retire_next = nullptr;
+    uint64_t retire_epoch = 0;
+    // INSERTED | ERASED, the second one to set its bit retires the node
+    std::atomic<uint32_t> handoff = {0};
+    uint32_t level;
+    // the level links are placed right behind the node
+    link* links() noexcept {
+      return reinterpret_cast<link*>(reinterpret_cast<char*>(this) +
+                                     sizeof(node));
+    }
+  };
+  static_assert(sizeof(node) % alignof(link) == 0,
+                "links must be aligned behind the node");
+  using node_alloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<node>;
+  using node_traits = std::allocator_traits<node_alloc>;
+
+  static node* ptr(uintptr_t l) noexcept {
+    return reinterpret_cast<node*>(l & ~MARKED);
+  }
+  static bool marked(uintptr_t l) noexcept { return (l & MARKED) != 0; }
+  static uintptr_t raw(node* n) noexcept {
+    return reinterpret_cast<uintptr_t>(n);
+  }
+  static const Key& key(node* n) noexcept { return KeyOf()(n->value); }
+
+  link head_[MAX_LEVEL] = {};
+  std::atomic<size_type> num_ = {0};
+  std::atomic<node*> retired_ = {nullptr};
+  std::atomic<uint32_t> retire_num_ = {0};
+  mutable epoch_domain domain_;
+  node_alloc alloc_;
+
+ public:
+  /**
+   * @brief const_iterator, valid while an epoch_guard of the list is held
+   *
+   */
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Value*;
+    using reference = const Value&;
+
+    const_iterator() = default;
+    reference operator*() const noexcept { return n_->value; }
+    pointer operator->() const noexcept { return &n_->value; }
+    const_iterator& operator++() noexcept {
+      n_ = next_live(ptr(n_->links()[0].load()));
+      return *this;
+    }
+    const_iterator operator++(int) noexcept {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const const_iterator& x) const noexcept {
+      return n_ == x.n_;
+    }
+    bool operator!=(const const_iterator& x) const noexcept {
+      return n_ != x.n_;
+    }
+
+   private:
+    friend class skip_list;
+    explicit const_iterator(node* n) noexcept : n_(n) {}
+    node* n_ = nullptr;
+  };
+
+  skip_list() = default;
+  ~skip_list() {
+    node* n = ptr(head_[0].load());
+    while (n != nullptr) {
+      node* next = ptr(n->links()[0].load());
+      destroy(n);
+      n = next;
+    }
+    free_chain(retired_.exchange(nullptr));
+  }
+  skip_list(const skip_list&) = delete;
+  skip_list& operator=(const skip_list&) = delete;
+
+  epoch_domain& domain() const noexcept { return domain_; }
+  size_type size() const noexcept { return num_.load(); }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(next_live(ptr(head_[0].load())));
+  }
+  const_iterator end() const noexcept { return const_iterator(); }
+  // First element not less than k, or greater than k if upper.
+  const_iterator bound(const Key& k, bool upper) const noexcept {
+    const link* links = head_;
+    node* curr = nullptr;
+    for (uint32_t i = MAX_LEVEL; i-- > 0;) {
+      curr = ptr(links[i].load());
+      while (curr != nullptr && (upper ? !Compare()(k, key(curr))
+                                       : Compare()(key(curr), k))) {
+        links = curr->links();
+        curr = ptr(links[i].load());
+      }
+    }
+    return const_iterator(next_live(curr));
+  }
+  const_iterator find(const Key& k) const noexcept {
+    const_iterator it = bound(k, false);
+    return it == end() || Compare()(k, key(it.n_)) ? end() : it;
+  }
+
+  // Inserts Value(args...) unless k is present.
+  template <class... Args>
+  std::pair<const_iterator, bool> find_or_emplace(const Key& k,
+                                                  Args&&... args) {
+    link* preds[MAX_LEVEL];
+    node* succs[MAX_LEVEL];
+    node* n = nullptr;
+    uint32_t top = random_level();
+    while (true) {
+      if (search(k, preds, succs)) {
+        if (n != nullptr) {
+          destroy(n);
+        }
+        return std::make_pair(const_iterator(succs[0]), false);
+      }
+      if (n == nullptr) {
+        n = create(top, std::forward<Args>(args)...);
+      }
+      for (uint32_t i = 0; i < top; i++) {
+        n->links()[i].store(raw(succs[i]));
+      }
+      // count first, so a racing erase never takes num_ below zero
+      num_.fetch_add(1);
+      uintptr_t expected = raw(succs[0]);
+      if (preds[0][0].compare_exchange_strong(expected, raw(n))) {
+        break;
+      }
+      num_.fetch_sub(1);
+    }
+    for (uint32_t i = 1; i < top; i++) {
+      if (!link_level(n, i, k, preds, succs)) {
+        break;
+      }
+    }
+    if (n->handoff.fetch_or(INSERTED) & ERASED) {
+      search(k, preds, succs);
+      retire(n);
+    }
+    return std::make_pair(const_iterator(n), true);
+  }
+  size_type erase(const Key& k) noexcept {
+    link* preds[MAX_LEVEL];
+    node* succs[MAX_LEVEL];
+    if (!search(k, preds, succs)) {
+      return 0;
+    }
+    node* n = succs[0];
+    for (uint32_t i = n->level; i-- > 1;) {
+      n->links()[i].fetch_or(MARKED);
+    }
+    if (marked(n->links()[0].fetch_or(MARKED))) {
+      // erased by someone else
+      return 0;
+    }
+    num_.fetch_sub(1);
+    if (n->handoff.fetch_or(ERASED) & INSERTED) {
+      // all levels are linked and marked, so one search snips them all
+      search(k, preds, succs);
+      retire(n);
+    }
+    return 1;
+  }
+  // Frees what is safe to free; call without holding a guard, so the
+  // epoch can move past the caller.
+  void collect() noexcept {
+    if (retire_num_.load() < RETIRE_BATCH) {
+      return;
+    }
+    retire_num_.store(0);
+    domain_.try_advance();
+    uint64_t epoch = domain_.try_advance();
+    node* keep = nullptr;
+    node* n = retired_.exchange(nullptr);
+    while (n != nullptr) {
+      node* next = n->retire_next;
+      if (epoch_domain::safe(n->retire_epoch, epoch)) {
+        destroy(n);
+      } else {
+        n->retire_next = keep;
+        keep = n;
+      }
+      n = next;
+    }
+    while (keep != nullptr) {
+      node* next = keep->retire_next;
+      push_retired(keep);
+      keep = next;
+    }
+  }
+
+ private:
+  static node* next_live(node* n) noexcept {
+    while (n != nullptr && marked(n->links()[0].load())) {
+      n = ptr(n->links()[0].load());
+    }
+    return n;
+  }
+  static uint32_t random_level() noexcept {
+    static std::atomic<uint64_t> seed = {0x9e3779b97f4a7c15ull};
+    static thread_local uint64_t x = seed.fetch_add(0x9e3779b97f4a7c15ull);
+    // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    uint32_t level = 1;
+    for (uint64_t bits = x; level < MAX_LEVEL && (bits & 3) == 0; bits >>= 2) {
+      level++;
+    }
+    return level;
+  }
+  template <class... Args>
+  node* create(uint32_t level, Args&&... args) {
+    size_type units =
+        (sizeof(node) + level * sizeof(link) + sizeof(node) - 1) / sizeof(node);
+    node* n = node_traits::allocate(alloc_, units);
+    ::new (static_cast<void*>(n)) node(level, std::forward<Args>(args)...);
+    for (uint32_t i = 0; i < level; i++) {
+      ::new (static_cast<void*>(n->links() + i)) link(0);
+    }
+    return n;
+  }
+  void destroy(node* n) noexcept {
+    size_type units = (sizeof(node) + n->level * sizeof(link) +
+                       sizeof(node) - 1) / sizeof(node);
+    n->~node();
+    node_traits::deallocate(alloc_, n, units);
+  }
+  void free_chain(node* n) noexcept {
+    while (n != nullptr) {
+      node* next = n->retire_next;
+      destroy(n);
+      n = next;
+    }
+  }
+  void push_retired(node* n) noexcept {
+    node* head = retired_.load();
+    do {
+      n->retire_next = head;
+    } while (!retired_.compare_exchange_weak(head, n));
+  }
+  void retire(node* n) noexcept {
+    n->retire_epoch = domain_.current();
+    push_retired(n);
+    retire_num_.fetch_add(1);
+  }
+  // Finds the predecessors and successors of k on every level, snipping
+  // marked nodes on the way; true if succs[0] holds k.
+  bool search(const Key& k, link** preds, node** succs) noexcept {
+  retry:
+    link* links = head_;
+    for (uint32_t i = MAX_LEVEL; i-- > 0;) {
+      node* curr = ptr(links[i].load());
+      while (curr != nullptr) {
+        uintptr_t succ = curr->links()[i].load();
+        while (marked(succ)) {
+          uintptr_t expected = raw(curr);
+          if (!links[i].compare_exchange_strong(expected, succ & ~MARKED)) {
+            goto retry;
+          }
+          curr = ptr(succ);
+          if (curr == nullptr) {
+            break;
+          }
+          succ = curr->links()[i].load();
+        }
+        if (curr == nullptr || !Compare()(key(curr), k)) {
+          break;
+        }
+        links = curr->links();
+        curr = ptr(succ);
+      }
+      preds[i] = links;
+      succs[i] = curr;
+    }
+    return succs[0] != nullptr && !Compare()(k, key(succs[0]));
+  }
+  // Links n on level i; false if n got erased meanwhile.
+  bool link_level(node* n, uint32_t i, const Key& k, link** preds,
+                  node** succs) noexcept {
+    while (true) {
+      uintptr_t l = n->links()[i].load();
+      if (marked(l)) {
+        return false;
+      }
+      if (ptr(l) != succs[i] &&
+          !n->links()[i].compare_exchange_strong(l, raw(succs[i]))) {
+        continue;
+      }
+      uintptr_t expected = raw(succs[i]);
+      if (preds[i][i].compare_exchange_strong(expected, raw(n))) {
+        return true;
+      }
+      if (!search(k, preds, succs) || succs[0] != n) {
+        return false;
+      }
+    }
+  }
+};
+}  // namespace detail
+}  // namespace tscontainer
+#endif  // __TSSKIPLIST_H__
@@ -0,0 +1,256 @@
+#ifndef __TSSKIPMAP_H__
+#define __TSSKIPMAP_H__
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "tsepoch.hpp"
+#include "tsskiplist.hpp"
+namespace tscontainer {
+/**
+ * @brief tsskipmap, lock-free ordered map on a skip list, for ordered data
+ * with heavy concurrent writes
+ *
+ * Readers and writers never take a lock and range scans run alongside
+ * inserts and erases. Erased nodes are reclaimed by epochs: iterators and
+ * the references they return stay valid while a guard from pin() is held,
+ * so hold one around find/lower_bound/upper_bound/equal_range, around
+ * insert/find_or_emplace if the returned iterator is used, and around any
+ * iteration. Values are immutable once inserted.
+ *
+ * ```C++
+ * auto guard = map.pin();
+ * for (auto it = map.lower_bound(10); it != map.upper_bound(20); ++it) {}
+ * ```
+ *
+ * @tparam Key key
+ * @tparam T t
+ * @tparam Compare compare
+ * @tparam std::allocator<std::pair<const Key, T>> alloc
+ */
+template <class Key, class T, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, T>>>
+class tsskipmap {
+ public:
+  // key_type
+  using key_type = Key;
+  // mapped_type
+  using mapped_type = T;
+  // value_type
+  using value_type = std::pair<const Key, T>;
+  // key_compare
+  using key_compare = Compare;
+
+ private:
+  struct key_of {
+    const Key& operator()(const value_type& v) const noexcept {
+      return v.first;
+    }
+  };
+  // list_type
+  using list_type = detail::skip_list<value_type, Key, key_of, Compare, Alloc>;
+  // list
+  list_type list;
+
+ public:
+  // const_iterator
+  using const_iterator = typename list_type::const_iterator;
+  // iterator, values cannot be changed in place
+  using iterator = const_iterator;
+  // size_type
+  using size_type = std::size_t;
+  // guard
+  using guard = epoch_guard;
+
+  /**
+   * @brief Construct a new tsskipmap object
+   *
+   */
+  tsskipmap() = default;
+
+  tsskipmap(const tsskipmap&) = delete;
+  tsskipmap& operator=(const tsskipmap&) = delete;
+
+  /**
+   * @brief pin, keeps iterators and references valid while held
+   *
+   * @return guard guard
+   */
+  guard pin() const noexcept { return guard(list.domain()); }
+  /**
+   * @brief begin
+   *
+   * @return const_iterator const_iterator
+   */
+  const_iterator begin() const noexcept { return list.begin(); }
+  /**
+   * @brief end
+   *
+   * @return const_iterator const_iterator
+   */
+  const_iterator end() const noexcept { return list.end(); }
+  /**
+   * @brief empty
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return list.size() == 0; }
+  /**
+   * @brief size
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept { return list.size(); }
+  /**
+   * @brief find, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return const_iterator const_iterator
+   */
+  const_iterator find(const key_type& k) const noexcept {
+    return list.find(k);
+  }
+  /**
+   * @brief lower_bound, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return const_iterator const_iterator
+   */
+  const_iterator lower_bound(const key_type& k) const noexcept {
+    return list.bound(k, false);
+  }
+  /**
+   * @brief upper_bound, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return const_iterator const_iterator
+   */
+  const_iterator upper_bound(const key_type& k) const noexcept {
+    return list.bound(k, true);
+  }
+  /**
+   * @brief equal_range, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return std::pair<const_iterator, const_iterator> std::pair
+   */
+  std::pair<const_iterator, const_iterator> equal_range(
+      const key_type& k) const noexcept {
+    return std::make_pair(lower_bound(k), upper_bound(k));
+  }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    guard g = pin();
+    return list.find(k) != list.end() ? 1 : 0;
+  }
+  /**
+   * @brief read_copy, see tsmap::read_copy
+   *
+   * @param k k
+   * @param value receives the value of k if found
+   * @return true k found
+   * @return false k not found, value untouched
+   */
+  bool read_copy(const key_type& k, mapped_type& value) const noexcept {
+    static_assert(std::is_trivially_copyable<mapped_type>::value,
+                  "read_copy needs a trivially copyable mapped_type");
+    guard g = pin();
+    const_iterator it = list.find(k);
+    if (it == list.end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+  /**
+   * @brief insert, hold a guard from pin(), taken before the call, while
+   * using the returned iterator
+   *
+   * @param val val
+   * @return std::pair<const_iterator, bool> std::pair
+   */
+  std::pair<const_iterator, bool> insert(const value_type& val) noexcept {
+    return find_or_insert(val);
+  }
+  /**
+   * @brief find_or_emplace, lock-free "look up, insert if missing"
+   *
+   * The internal guard is gone once the call returns, so hold a guard from
+   * pin(), taken before the call, while using the returned iterator.
+   *
+   * @tparam Args Args
+   * @param k k
+   * @param args arguments to construct the mapped value on a miss
+   * @return std::pair<const_iterator, bool> std::pair, true if inserted
+   */
+  template <class... Args>
+  std::pair<const_iterator, bool> find_or_emplace(const key_type& k,
+                                                  Args&&... args) noexcept {
+    guard g = pin();
+    return list.find_or_emplace(
+        k, std::piecewise_construct, std::forward_as_tuple(k),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+  /**
+   * @brief find_or_insert, hold a guard from pin(), taken before the call,
+   * while using the returned iterator
+   *
+   * @param val val
+   * @return std::pair<const_iterator, bool> std::pair, true if inserted
+   */
+  std::pair<const_iterator, bool> find_or_insert(
+      const value_type& val) noexcept {
+    guard g = pin();
+    return list.find_or_emplace(val.first, val);
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept {
+    size_type count = 0;
+    {
+      guard g = pin();
+      count = list.erase(k);
+    }
+    list.collect();
+    return count;
+  }
+  /**
+   * @brief clear, erases element by element; concurrent inserts may survive
+   *
+   */
+  void clear() noexcept {
+    {
+      guard g = pin();
+      for (const_iterator it = list.begin(); it != list.end(); ++it) {
+        list.erase(it->first);
+      }
+    }
+    list.collect();
+  }
+  /**
+   * @brief call_each, ordered scan that does not block writers
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) const noexcept {
+    guard g = pin();
+    for (const value_type& v : list) {
+      pred(v);
+    }
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSSKIPMAP_H__
@@ -0,0 +1,190 @@
+#ifndef __TSSKIPSET_H__
+#define __TSSKIPSET_H__
+#include <functional>
+#include <memory>
+#include <utility>
+#include "tsepoch.hpp"
+#include "tsskiplist.hpp"
+namespace tscontainer {
+/**
+ * @brief tsskipset, lock-free ordered set on a skip list, see tsskipmap
+ *
+ * Iterators stay valid while a guard from pin() is held.
+ *
+ * @tparam Key key
+ * @tparam Compare compare
+ * @tparam std::allocator<Key> alloc
+ */
+template <class Key, class Compare = std::less<Key>,
+          class Alloc = std::allocator<Key>>
+class tsskipset {
+ public:
+  // key_type
+  using key_type = Key;
+  // value_type
+  using value_type = Key;
+  // key_compare
+  using key_compare = Compare;
+
+ private:
+  struct key_of {
+    const Key& operator()(const value_type& v) const noexcept { return v; }
+  };
+  // list_type
+  using list_type =
+      detail::skip_list<const value_type, Key, key_of, Compare, Alloc>;
+  // list
+  list_type list;
+
+ public:
+  // const_iterator
+  using const_iterator = typename list_type::const_iterator;
+  // iterator
+  using iterator = const_iterator;
+  // size_type
+  using size_type = std::size_t;
+  // guard
+  using guard = epoch_guard;
+
+  /**
+   * @brief Construct a new tsskipset object
+   *
+   */
+  tsskipset() = default;
+
+  tsskipset(const tsskipset&) = delete;
+  tsskipset& operator=(const tsskipset&) = delete;
+
+  /**
+   * @brief pin, keeps iterators valid while held
+   *
+   * @return guard guard
+   */
+  guard pin() const noexcept { return guard(list.domain()); }
+  /**
+   * @brief begin
+   *
+   * @return const_iterator const_iterator
+   */
+  const_iterator begin() const noexcept { return list.begin(); }
+  /**
+   * @brief end
+   *
+   * @return const_iterator const_iterator
+   */
+  const_iterator end() const noexcept { return list.end(); }
+  /**
+   * @brief empty
+   *
+   * @return true true
+   * @return false false
+   */
+  bool empty() const noexcept { return list.size() == 0; }
+  /**
+   * @brief size
+   *
+   * @return size_type size
+   */
+  size_type size() const noexcept { return list.size(); }
+  /**
+   * @brief find, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return const_iterator const_iterator
+   */
+  const_iterator find(const key_type& k) const noexcept {
+    return list.find(k);
+  }
+  /**
+   * @brief lower_bound, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return const_iterator const_iterator
+   */
+  const_iterator lower_bound(const key_type& k) const noexcept {
+    return list.bound(k, false);
+  }
+  /**
+   * @brief upper_bound, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return const_iterator const_iterator
+   */
+  const_iterator upper_bound(const key_type& k) const noexcept {
+    return list.bound(k, true);
+  }
+  /**
+   * @brief equal_range, hold a guard from pin() while using the result
+   *
+   * @param k k
+   * @return std::pair<const_iterator, const_iterator> std::pair
+   */
+  std::pair<const_iterator, const_iterator> equal_range(
+      const key_type& k) const noexcept {
+    return std::make_pair(lower_bound(k), upper_bound(k));
+  }
+  /**
+   * @brief count
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type count(const key_type& k) const noexcept {
+    guard g = pin();
+    return list.find(k) != list.end() ? 1 : 0;
+  }
+  /**
+   * @brief insert, hold a guard from pin(), taken before the call, while
+   * using the returned iterator
+   *
+   * @param val val
+   * @return std::pair<const_iterator, bool> std::pair
+   */
+  std::pair<const_iterator, bool> insert(const value_type& val) noexcept {
+    guard g = pin();
+    return list.find_or_emplace(val, val);
+  }
+  /**
+   * @brief erase
+   *
+   * @param k k
+   * @return size_type size_type
+   */
+  size_type erase(const key_type& k) noexcept {
+    size_type count = 0;
+    {
+      guard g = pin();
+      count = list.erase(k);
+    }
+    list.collect();
+    return count;
+  }
+  /**
+   * @brief clear, erases element by element; concurrent inserts may survive
+   *
+   */
+  void clear() noexcept {
+    {
+      guard g = pin();
+      for (const_iterator it = list.begin(); it != list.end(); ++it) {
+        list.erase(*it);
+      }
+    }
+    list.collect();
+  }
+  /**
+   * @brief call_each, ordered scan that does not block writers
+   *
+   * @tparam P p
+   * @param pred pred
+   */
+  template <typename P>
+  void call_each(P pred) const noexcept {
+    guard g = pin();
+    for (const value_type& v : list) {
+      pred(v);
+    }
+  }
+};
+}  // namespace tscontainer
+#endif  // __TSSKIPSET_H__
@@ -0,0 +1,284 @@
+#ifndef __TSSNAPSHOT_H__
+#define __TSSNAPSHOT_H__
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace tscontainer {
+/**
+ * @brief snapshot_traits, fixed-size binary encoding of keys and values in
+ * snapshot files
+ *
+ * The default copies the object representation, so it needs a trivially
+ * copyable T. Specialize it to store other types; every value of a type has
+ * to encode to exactly SIZE bytes.
+ *
+ * @tparam T T
+ */
+template <class T>
+struct snapshot_traits {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "specialize snapshot_traits for this type");
+  // bytes per encoded value
+  static const std::size_t SIZE = sizeof(T);
+  static void write(const T& v, char* out) noexcept {
+    std::memcpy(out, &v, sizeof(T));
+  }
+  static T read(const char* in) noexcept {
+    T v;
+    std::memcpy(&v, in, sizeof(T));
+    return v;
+  }
+};
+
+namespace detail {
+/**
+ * @brief snapshot_header, start of a snapshot file, followed by count
+ * records of key_size + value_size bytes in ascending key order; integers
+ * are in native byte order
+ *
+ */
+struct snapshot_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t key_size;
+  // 0 for sets
+  uint64_t value_size;
+  uint64_t count;
+};
+static const char SNAPSHOT_MAGIC[8] = {'T', 'S', 'S', 'N',
+                                       'A', 'P', '\0', '\0'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * @brief snapshot_writer, writes a snapshot to a temporary file next to path
+ * (path.XXXXXX, unique per writer), syncs it and renames it to path on
+ * commit(), so readers never see a partial file and concurrent saves to the
+ * same path do not mix
+ *
+ */
+class snapshot_writer {
+ public:
+  snapshot_writer(const std::string& path, std::size_t key_size,
+                  std::size_t value_size) noexcept
+      : path_(path),
+        key_size_(key_size),
+        value_size_(value_size),
+        record_(key_size + value_size) {
+#if defined(__unix__) || defined(__APPLE__)
+    std::vector<char> tmp(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    tmp.insert(tmp.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkstemp(tmp.data());
+    if (fd < 0) {
+      return;
+    }
+    tmp_ = tmp.data();
+    // mkstemp creates the file private to the owner
+    fchmod(fd, 0644);
+    file_ = fdopen(fd, "wb");
+    if (file_ == nullptr) {
+      ::close(fd);
+      std::remove(tmp_.c_str());
+      return;
+    }
+#else
+    tmp_ = path + ".tmp";
+    file_ = std::fopen(tmp_.c_str(), "wb");
+    if (file_ == nullptr) {
+      return;
+    }
+#endif
+    buf_.reserve(BUFFER_BYTES);
+  }
+  ~snapshot_writer() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+      std::remove(tmp_.c_str());
+    }
+  }
+  snapshot_writer(const snapshot_writer&) = delete;
+  snapshot_writer& operator=(const snapshot_writer&) = delete;
+
+  // Writes the header; count records have to follow.
+  void start(uint64_t count) noexcept {
+    if (file_ == nullptr) {
+      return;
+    }
+    snapshot_header h;
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.key_size = static_cast<uint32_t>(key_size_);
+    h.value_size = value_size_;
+    h.count = count;
+    ok_ = std::fwrite(&h, sizeof(h), 1, file_) == 1;
+  }
+  // Space for the next record, to be filled by the caller.
+  char* next() noexcept {
+    if (buf_.size() + record_ > BUFFER_BYTES) {
+      flush();
+    }
+    buf_.resize(buf_.size() + record_);
+    return buf_.data() + buf_.size() - record_;
+  }
+  // false if anything failed; path then still holds the previous snapshot,
+  // unless only the final directory sync failed: the new snapshot is in
+  // place but may not survive a crash.
+  bool commit() noexcept {
+    if (file_ == nullptr) {
+      return false;
+    }
+    flush();
+    ok_ = std::fflush(file_) == 0 && ok_;
+#if defined(__unix__) || defined(__APPLE__)
+    // the data has to be on disk before the rename can make it visible
+    ok_ = ok_ && ::fsync(fileno(file_)) == 0;
+#endif
+    ok_ = std::fclose(file_) == 0 && ok_;
+    file_ = nullptr;
+    if (!ok_ || std::rename(tmp_.c_str(), path_.c_str()) != 0) {
+      std::remove(tmp_.c_str());
+      return false;
+    }
+    return sync_dir();
+  }
+
+ private:
+  static const std::size_t BUFFER_BYTES = 1 << 20;
+  void flush() noexcept {
+    if (!buf_.empty()) {
+      ok_ = std::fwrite(buf_.data(), 1, buf_.size(), file_) == buf_.size() &&
+            ok_;
+      buf_.clear();
+    }
+  }
+  // Persist the rename itself.
+  bool sync_dir() const noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+    std::string dir = ".";
+    std::string::size_type slash = path_.rfind('/');
+    if (slash != std::string::npos) {
+      dir = slash == 0 ? "/" : path_.substr(0, slash);
+    }
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    return true;
+#endif
+  }
+  std::string path_;
+  std::string tmp_;
+  std::size_t key_size_;
+  std::size_t value_size_;
+  std::size_t record_;
+  std::FILE* file_ = nullptr;
+  bool ok_ = false;
+  std::vector<char> buf_;
+};
+
+/**
+ * @brief snapshot_reader, maps a snapshot file read-only (reads it into
+ * memory where mmap is not available) and checks its header
+ *
+ */
+class snapshot_reader {
+ public:
+  snapshot_reader(const std::string& path, std::size_t key_size,
+                  std::size_t value_size) noexcept {
+    if (!open(path)) {
+      return;
+    }
+    snapshot_header h;
+    if (size_ < sizeof(h)) {
+      return;
+    }
+    std::memcpy(&h, data_, sizeof(h));
+    std::size_t record = key_size + value_size;
+    valid_ = std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) == 0 &&
+             h.version == SNAPSHOT_VERSION && h.key_size == key_size &&
+             h.value_size == value_size &&
+             h.count == (size_ - sizeof(h)) / record &&
+             (size_ - sizeof(h)) % record == 0;
+    count_ = h.count;
+  }
+  ~snapshot_reader() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (data_ != nullptr && size_ > 0) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+  }
+  snapshot_reader(const snapshot_reader&) = delete;
+  snapshot_reader& operator=(const snapshot_reader&) = delete;
+
+  bool valid() const noexcept { return valid_; }
+  uint64_t count() const noexcept { return count_; }
+  // First record.
+  const char* records() const noexcept {
+    return data_ + sizeof(snapshot_header);
+  }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  uint64_t count_ = 0;
+  bool valid_ = false;
+#if !defined(__unix__) && !defined(__APPLE__)
+  std::vector<char> copy_;
+#endif
+
+  bool open(const std::string& path) noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+    void* p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                   MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    // one sequential pass follows
+    madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(p);
+    size_ = static_cast<std::size_t>(st.st_size);
+    return true;
+#else
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+      return false;
+    }
+    char buf[1 << 16];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;) {
+      copy_.insert(copy_.end(), buf, buf + n);
+    }
+    std::fclose(f);
+    data_ = copy_.data();
+    size_ = copy_.size();
+    return true;
+#endif
+  }
+};
+}  // namespace detail
+}  // namespace tscontainer
+#endif  // __TSSNAPSHOT_H__